@@ -7,7 +7,27 @@
 #include <sstream>
 #include <chrono>
 #include <numeric>
+#include <limits>
+#include <charconv>
+#include <cstdlib>
 #include <iomanip>
+#include <cstring>
+#include <ctime>
+#include <thread>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <atomic>
+#include <cerrno>
+#include <random>
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using NumberFormat::shortest;
 
 // MARK: - Math utilities implementation
 
@@ -17,13 +37,13 @@ namespace MathUtils {
     }
     
     double multiply(double a, double b) {
-        std::cout << "C++: Multiplying " << a << " * " << b << std::endl;
+        std::cout << "C++: Multiplying " << shortest(a) << " * " << shortest(b) << std::endl;
         return a * b;
     }
     
     double power(double base, double exponent) {
         double result = std::pow(base, exponent);
-        std::cout << "C++: " << base << "^" << exponent << " = " << result << std::endl;
+        std::cout << "C++: " << shortest(base) << "^" << shortest(exponent) << " = " << shortest(result) << std::endl;
         return result;
     }
     
@@ -36,7 +56,7 @@ namespace MathUtils {
             result *= i;
         }
         
-        std::cout << "C++: " << n << "! = " << result << std::endl;
+        std::cout << "C++: " << n << "! = " << shortest(result) << std::endl;
         return result;
     }
     
@@ -54,6 +74,109 @@ namespace MathUtils {
     }
 }
 
+// MARK: - Number formatting implementation
+
+namespace NumberFormat {
+    size_t formatDouble(double value, char* buffer, size_t size) {
+        if (buffer == nullptr || size == 0) return 0;
+#if defined(__cpp_lib_to_chars)
+        auto result = std::to_chars(buffer, buffer + size - 1, value);
+        if (result.ec != std::errc()) return 0;
+        *result.ptr = '\0';
+        return static_cast<size_t>(result.ptr - buffer);
+#else
+        // No floating-point to_chars: the shortest %g that round-trips
+        char text[kMaxDoubleLength];
+        int length = 0;
+        for (int precision = 15; precision <= 17; ++precision) {
+            length = std::snprintf(text, sizeof(text), "%.*g", precision, value);
+            if (std::strtod(text, nullptr) == value) break;
+        }
+        if (length <= 0 || static_cast<size_t>(length) >= size) return 0;
+        std::memcpy(buffer, text, static_cast<size_t>(length) + 1);
+        return static_cast<size_t>(length);
+#endif
+    }
+
+    size_t formatFixed(double value, int precision, char* buffer, size_t size) {
+        if (buffer == nullptr || size == 0) return 0;
+#if defined(__cpp_lib_to_chars)
+        auto result = std::to_chars(buffer, buffer + size - 1, value, std::chars_format::fixed, precision);
+        if (result.ec != std::errc()) return 0;
+        *result.ptr = '\0';
+        return static_cast<size_t>(result.ptr - buffer);
+#else
+        int length = std::snprintf(buffer, size, "%.*f", precision, value);
+        return length > 0 && static_cast<size_t>(length) < size ? static_cast<size_t>(length) : 0;
+#endif
+    }
+
+    size_t formatInteger(long long value, char* buffer, size_t size) {
+        if (buffer == nullptr || size == 0) return 0;
+        auto result = std::to_chars(buffer, buffer + size - 1, value);
+        if (result.ec != std::errc()) return 0;
+        *result.ptr = '\0';
+        return static_cast<size_t>(result.ptr - buffer);
+    }
+
+    size_t parseDouble(const char* text, size_t length, double* value) {
+#if defined(__cpp_lib_to_chars)
+        auto result = std::from_chars(text, text + length, *value);
+        if (result.ec != std::errc()) return 0;
+        return static_cast<size_t>(result.ptr - text);
+#else
+        // strtod needs a terminated string
+        char number[64];
+        size_t n = std::min(length, sizeof(number) - 1);
+        std::memcpy(number, text, n);
+        number[n] = '\0';
+        char* end = nullptr;
+        double parsed = std::strtod(number, &end);
+        if (end == number) return 0;
+        *value = parsed;
+        return static_cast<size_t>(end - number);
+#endif
+    }
+
+    size_t formatDoubles(const double* values, size_t count, char separator, char* buffer, size_t size) {
+        size_t length = 0;
+        for (size_t i = 0; i < count; ++i) {
+            if (i > 0) {
+                if (length + 1 >= size) return 0;
+                buffer[length++] = separator;
+            }
+            size_t written = formatDouble(values[i], buffer + length, size - length);
+            if (written == 0) return 0;
+            length += written;
+        }
+        if (length < size) buffer[length] = '\0';
+        return length;
+    }
+
+    size_t parseDoubles(const char* text, size_t length, double* values, size_t maxCount) {
+        size_t count = 0;
+        size_t i = 0;
+        while (count < maxCount) {
+            while (i < length && (text[i] == ',' || text[i] == ' ' || text[i] == '\t' ||
+                                  text[i] == '\n' || text[i] == '\r')) {
+                ++i;
+            }
+            if (i == length) break;
+            size_t consumed = parseDouble(text + i, length - i, &values[count]);
+            if (consumed == 0) break;
+            i += consumed;
+            ++count;
+        }
+        return count;
+    }
+
+    std::ostream& operator<<(std::ostream& os, Shortest number) {
+        char buffer[kMaxDoubleLength];
+        size_t length = formatDouble(number.value, buffer, sizeof(buffer));
+        return os.write(buffer, static_cast<std::streamsize>(length));
+    }
+}
+
 // MARK: - Vector3D implementation
 
 Vector3D::Vector3D() : x_(0), y_(0), z_(0) {
@@ -61,7 +184,7 @@ Vector3D::Vector3D() : x_(0), y_(0), z_(0) {
 }
 
 Vector3D::Vector3D(double x, double y, double z) : x_(x), y_(y), z_(z) {
-    std::cout << "C++: Vector3D created: (" << x << ", " << y << ", " << z << ")" << std::endl;
+    std::cout << "C++: Vector3D created: (" << shortest(x) << ", " << shortest(y) << ", " << shortest(z) << ")" << std::endl;
 }
 
 Vector3D Vector3D::add(const Vector3D& other) const {
@@ -78,7 +201,7 @@ Vector3D Vector3D::multiply(double scalar) const {
 
 double Vector3D::dot(const Vector3D& other) const {
     double result = x_ * other.x_ + y_ * other.y_ + z_ * other.z_;
-    std::cout << "C++: Dot product = " << result << std::endl;
+    std::cout << "C++: Dot product = " << shortest(result) << std::endl;
     return result;
 }
 
@@ -92,7 +215,7 @@ Vector3D Vector3D::cross(const Vector3D& other) const {
 
 double Vector3D::magnitude() const {
     double mag = std::sqrt(x_ * x_ + y_ * y_ + z_ * z_);
-    std::cout << "C++: Vector magnitude = " << mag << std::endl;
+    std::cout << "C++: Vector magnitude = " << shortest(mag) << std::endl;
     return mag;
 }
 
@@ -103,13 +226,343 @@ Vector3D Vector3D::normalize() const {
 }
 
 void Vector3D::print() const {
-    std::cout << "C++: Vector3D(" << x_ << ", " << y_ << ", " << z_ << ")" << std::endl;
+    char buffer[kMaxStringLength];
+    size_t length = toChars(buffer, sizeof(buffer));
+    std::cout << "C++: Vector3D";
+    std::cout.write(buffer, static_cast<std::streamsize>(length)) << std::endl;
 }
 
 std::string Vector3D::toString() const {
-    std::ostringstream oss;
-    oss << "(" << x_ << ", " << y_ << ", " << z_ << ")";
-    return oss.str();
+    char buffer[kMaxStringLength];
+    return std::string(buffer, toChars(buffer, sizeof(buffer)));
+}
+
+size_t Vector3D::toChars(char* buffer, size_t size) const {
+    if (size < kMaxStringLength) return 0;
+    char* p = buffer;
+    *p++ = '(';
+    p += NumberFormat::formatDouble(x_, p, NumberFormat::kMaxDoubleLength);
+    *p++ = ',';
+    *p++ = ' ';
+    p += NumberFormat::formatDouble(y_, p, NumberFormat::kMaxDoubleLength);
+    *p++ = ',';
+    *p++ = ' ';
+    p += NumberFormat::formatDouble(z_, p, NumberFormat::kMaxDoubleLength);
+    *p++ = ')';
+    *p = '\0';
+    return static_cast<size_t>(p - buffer);
+}
+
+size_t Vector3D::formatArray(const Vector3D* vectors, size_t count, char* buffer, size_t size) {
+    size_t length = 0;
+    for (size_t i = 0; i < count; ++i) {
+        // Room for the worst case line, so the loop needs no other bound check
+        if (size - length < kMaxStringLength) return 0;
+        char* p = buffer + length;
+        p += NumberFormat::formatDouble(vectors[i].x_, p, NumberFormat::kMaxDoubleLength);
+        *p++ = ' ';
+        p += NumberFormat::formatDouble(vectors[i].y_, p, NumberFormat::kMaxDoubleLength);
+        *p++ = ' ';
+        p += NumberFormat::formatDouble(vectors[i].z_, p, NumberFormat::kMaxDoubleLength);
+        *p++ = '\n';
+        length = static_cast<size_t>(p - buffer);
+    }
+    if (length < size) buffer[length] = '\0';
+    return length;
+}
+
+// MARK: - Vector3 implementation
+
+template <typename T>
+Vector3<T> Vector3<T>::add(const Vector3& other) const {
+    return Vector3(this->x + other.x, this->y + other.y, this->z + other.z);
+}
+
+template <typename T>
+Vector3<T> Vector3<T>::subtract(const Vector3& other) const {
+    return Vector3(this->x - other.x, this->y - other.y, this->z - other.z);
+}
+
+template <typename T>
+Vector3<T> Vector3<T>::multiply(T scalar) const {
+    return Vector3(this->x * scalar, this->y * scalar, this->z * scalar);
+}
+
+template <typename T>
+T Vector3<T>::dot(const Vector3& other) const {
+    return this->x * other.x + this->y * other.y + this->z * other.z;
+}
+
+template <typename T>
+Vector3<T> Vector3<T>::cross(const Vector3& other) const {
+    return Vector3(
+        this->y * other.z - this->z * other.y,
+        this->z * other.x - this->x * other.z,
+        this->x * other.y - this->y * other.x
+    );
+}
+
+template <typename T>
+T Vector3<T>::magnitude() const {
+    return std::sqrt(dot(*this));
+}
+
+template <typename T>
+Vector3<T> Vector3<T>::normalize() const {
+    T mag = magnitude();
+    if (mag == 0) return Vector3();
+    return multiply(1 / mag);
+}
+
+template class Vector3<float>;
+template class Vector3<double>;
+
+namespace Vector3Convert {
+    void toFloat(const Vector3d* in, Vector3f* out, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            out[i] = Vector3f(static_cast<float>(in[i].x), static_cast<float>(in[i].y), static_cast<float>(in[i].z));
+        }
+    }
+
+    void toDouble(const Vector3f* in, Vector3d* out, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            out[i] = Vector3d(in[i].x, in[i].y, in[i].z);
+        }
+    }
+
+    void toFloat(const double* xyz, Vector3f* out, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            out[i] = Vector3f(static_cast<float>(xyz[3 * i]), static_cast<float>(xyz[3 * i + 1]),
+                              static_cast<float>(xyz[3 * i + 2]));
+        }
+    }
+
+    void toDouble(const Vector3f* in, double* xyz, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            xyz[3 * i] = in[i].x;
+            xyz[3 * i + 1] = in[i].y;
+            xyz[3 * i + 2] = in[i].z;
+        }
+    }
+}
+
+// MARK: - Matrix and quaternion implementation
+
+namespace {
+    // Kernels over the upper 3x4 part of a row-major matrix. Each iteration
+    // only reads and writes its own vector, so `out` may be `in`; the loops
+    // have no branches or calls and are marked `omp simd` (see SCsub), so
+    // they vectorize at -O2.
+    template <bool Translate, bool Normalize>
+    void affineAoS(const double* m, const double* in, double* out, size_t count) {
+        const double m00 = m[0], m01 = m[1], m02 = m[2], m03 = Translate ? m[3] : 0.0;
+        const double m10 = m[4], m11 = m[5], m12 = m[6], m13 = Translate ? m[7] : 0.0;
+        const double m20 = m[8], m21 = m[9], m22 = m[10], m23 = Translate ? m[11] : 0.0;
+        #pragma omp simd
+        for (size_t i = 0; i < count; ++i) {
+            const double x = in[3 * i], y = in[3 * i + 1], z = in[3 * i + 2];
+            double rx = m00 * x + m01 * y + m02 * z + m03;
+            double ry = m10 * x + m11 * y + m12 * z + m13;
+            double rz = m20 * x + m21 * y + m22 * z + m23;
+            if (Normalize) {
+                // 0 for a zero vector, without a branch around the division
+                const double squared = rx * rx + ry * ry + rz * rz;
+                const double zero = squared > 0.0 ? 0.0 : 1.0;
+                const double scale = (1.0 - zero) / std::sqrt(squared + zero);
+                rx *= scale;
+                ry *= scale;
+                rz *= scale;
+            }
+            out[3 * i] = rx;
+            out[3 * i + 1] = ry;
+            out[3 * i + 2] = rz;
+        }
+    }
+
+    template <bool Translate, bool Normalize>
+    void affineSoA(const double* m, const double* inX, const double* inY, const double* inZ,
+                   double* outX, double* outY, double* outZ, size_t count) {
+        const double m00 = m[0], m01 = m[1], m02 = m[2], m03 = Translate ? m[3] : 0.0;
+        const double m10 = m[4], m11 = m[5], m12 = m[6], m13 = Translate ? m[7] : 0.0;
+        const double m20 = m[8], m21 = m[9], m22 = m[10], m23 = Translate ? m[11] : 0.0;
+        #pragma omp simd
+        for (size_t i = 0; i < count; ++i) {
+            const double x = inX[i], y = inY[i], z = inZ[i];
+            double rx = m00 * x + m01 * y + m02 * z + m03;
+            double ry = m10 * x + m11 * y + m12 * z + m13;
+            double rz = m20 * x + m21 * y + m22 * z + m23;
+            if (Normalize) {
+                const double squared = rx * rx + ry * ry + rz * rz;
+                const double zero = squared > 0.0 ? 0.0 : 1.0;
+                const double scale = (1.0 - zero) / std::sqrt(squared + zero);
+                rx *= scale;
+                ry *= scale;
+                rz *= scale;
+            }
+            outX[i] = rx;
+            outY[i] = ry;
+            outZ[i] = rz;
+        }
+    }
+
+    // Upper 3x4 part of the rotation matrix of a unit quaternion
+    void quaternionMatrix(double w, double x, double y, double z, double* m) {
+        m[0] = 1 - 2 * (y * y + z * z); m[1] = 2 * (x * y - w * z);     m[2] = 2 * (x * z + w * y);      m[3] = 0;
+        m[4] = 2 * (x * y + w * z);     m[5] = 1 - 2 * (x * x + z * z); m[6] = 2 * (y * z - w * x);      m[7] = 0;
+        m[8] = 2 * (x * z - w * y);     m[9] = 2 * (y * z + w * x);     m[10] = 1 - 2 * (x * x + y * y); m[11] = 0;
+    }
+}
+
+Quaternion::Quaternion() : w_(1), x_(0), y_(0), z_(0) {}
+
+Quaternion::Quaternion(double w, double x, double y, double z) : w_(w), x_(x), y_(y), z_(z) {}
+
+Quaternion Quaternion::fromAxisAngle(const Vector3D& axis, double radians) {
+    double length = std::sqrt(axis.getX() * axis.getX() + axis.getY() * axis.getY() + axis.getZ() * axis.getZ());
+    if (length == 0) return Quaternion();
+    double s = std::sin(radians / 2) / length;
+    return Quaternion(std::cos(radians / 2), axis.getX() * s, axis.getY() * s, axis.getZ() * s);
+}
+
+Quaternion Quaternion::multiply(const Quaternion& o) const {
+    return Quaternion(
+        w_ * o.w_ - x_ * o.x_ - y_ * o.y_ - z_ * o.z_,
+        w_ * o.x_ + x_ * o.w_ + y_ * o.z_ - z_ * o.y_,
+        w_ * o.y_ - x_ * o.z_ + y_ * o.w_ + z_ * o.x_,
+        w_ * o.z_ + x_ * o.y_ - y_ * o.x_ + z_ * o.w_
+    );
+}
+
+Quaternion Quaternion::conjugate() const {
+    return Quaternion(w_, -x_, -y_, -z_);
+}
+
+Quaternion Quaternion::normalize() const {
+    double length = std::sqrt(w_ * w_ + x_ * x_ + y_ * y_ + z_ * z_);
+    if (length == 0) return Quaternion();
+    return Quaternion(w_ / length, x_ / length, y_ / length, z_ / length);
+}
+
+Vector3D Quaternion::rotate(const Vector3D& v) const {
+    double m[12];
+    quaternionMatrix(w_, x_, y_, z_, m);
+    double in[3] = {v.getX(), v.getY(), v.getZ()};
+    double out[3];
+    affineAoS<false, false>(m, in, out, 1);
+    return Vector3D(out[0], out[1], out[2]);
+}
+
+Matrix4x4 Quaternion::toMatrix() const {
+    return Matrix4x4::rotation(*this);
+}
+
+void Quaternion::rotateAoS(const double* in, double* out, size_t count) const {
+    double m[12];
+    quaternionMatrix(w_, x_, y_, z_, m);
+    affineAoS<false, false>(m, in, out, count);
+}
+
+void Quaternion::rotateSoA(const double* inX, const double* inY, const double* inZ,
+                           double* outX, double* outY, double* outZ, size_t count) const {
+    double m[12];
+    quaternionMatrix(w_, x_, y_, z_, m);
+    affineSoA<false, false>(m, inX, inY, inZ, outX, outY, outZ, count);
+}
+
+void Quaternion::rotateNormalizeAoS(const double* in, double* out, size_t count) const {
+    double m[12];
+    quaternionMatrix(w_, x_, y_, z_, m);
+    affineAoS<false, true>(m, in, out, count);
+}
+
+void Quaternion::rotateNormalizeSoA(const double* inX, const double* inY, const double* inZ,
+                                    double* outX, double* outY, double* outZ, size_t count) const {
+    double m[12];
+    quaternionMatrix(w_, x_, y_, z_, m);
+    affineSoA<false, true>(m, inX, inY, inZ, outX, outY, outZ, count);
+}
+
+Matrix4x4::Matrix4x4() : m_{1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1} {}
+
+Matrix4x4::Matrix4x4(const double* rowMajor) {
+    std::copy(rowMajor, rowMajor + 16, m_);
+}
+
+Matrix4x4 Matrix4x4::translation(double x, double y, double z) {
+    Matrix4x4 result;
+    result.m_[3] = x;
+    result.m_[7] = y;
+    result.m_[11] = z;
+    return result;
+}
+
+Matrix4x4 Matrix4x4::scale(double x, double y, double z) {
+    Matrix4x4 result;
+    result.m_[0] = x;
+    result.m_[5] = y;
+    result.m_[10] = z;
+    return result;
+}
+
+Matrix4x4 Matrix4x4::rotation(const Quaternion& q) {
+    Matrix4x4 result;
+    quaternionMatrix(q.getW(), q.getX(), q.getY(), q.getZ(), result.m_);
+    return result;
+}
+
+Matrix4x4 Matrix4x4::multiply(const Matrix4x4& other) const {
+    Matrix4x4 result;
+    for (int row = 0; row < 4; ++row) {
+        for (int column = 0; column < 4; ++column) {
+            double sum = 0;
+            for (int k = 0; k < 4; ++k) {
+                sum += m_[row * 4 + k] * other.m_[k * 4 + column];
+            }
+            result.m_[row * 4 + column] = sum;
+        }
+    }
+    return result;
+}
+
+Vector3D Matrix4x4::transformPoint(const Vector3D& p) const {
+    double in[3] = {p.getX(), p.getY(), p.getZ()};
+    double out[3];
+    affineAoS<true, false>(m_, in, out, 1);
+    return Vector3D(out[0], out[1], out[2]);
+}
+
+Vector3D Matrix4x4::transformDirection(const Vector3D& d) const {
+    double in[3] = {d.getX(), d.getY(), d.getZ()};
+    double out[3];
+    affineAoS<false, false>(m_, in, out, 1);
+    return Vector3D(out[0], out[1], out[2]);
+}
+
+void Matrix4x4::transformPointsAoS(const double* in, double* out, size_t count) const {
+    affineAoS<true, false>(m_, in, out, count);
+}
+
+void Matrix4x4::transformPointsSoA(const double* inX, const double* inY, const double* inZ,
+                                   double* outX, double* outY, double* outZ, size_t count) const {
+    affineSoA<true, false>(m_, inX, inY, inZ, outX, outY, outZ, count);
+}
+
+void Matrix4x4::transformDirectionsAoS(const double* in, double* out, size_t count) const {
+    affineAoS<false, false>(m_, in, out, count);
+}
+
+void Matrix4x4::transformDirectionsSoA(const double* inX, const double* inY, const double* inZ,
+                                       double* outX, double* outY, double* outZ, size_t count) const {
+    affineSoA<false, false>(m_, inX, inY, inZ, outX, outY, outZ, count);
+}
+
+void Matrix4x4::transformNormalizeAoS(const double* in, double* out, size_t count) const {
+    affineAoS<false, true>(m_, in, out, count);
+}
+
+void Matrix4x4::transformNormalizeSoA(const double* inX, const double* inY, const double* inZ,
+                                      double* outX, double* outY, double* outZ, size_t count) const {
+    affineSoA<false, true>(m_, inX, inY, inZ, outX, outY, outZ, count);
 }
 
 // MARK: - String utilities implementation
@@ -168,6 +621,713 @@ namespace StringUtils {
     }
 }
 
+// MARK: - HyperLogLog implementation
+
+namespace {
+    // Hash of a double's bits (murmur3 finalizer), with +0.0/-0.0 and all
+    // NaNs mapped to one value. The mapping selects between 64-bit integers,
+    // the width of the hash, so bulk hashing vectorizes.
+    inline uint64_t hashDouble(double value) {
+        const uint64_t nan = 0x7ff8000000000000ULL;
+        uint64_t h;
+        std::memcpy(&h, &value, sizeof(h));
+        h = value == 0.0 ? 0 : h;
+        h = value != value ? nan : h;
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    inline int leadingZeros(uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+        return x ? __builtin_clzll(x) : 64;
+#else
+        int n = 0;
+        for (uint64_t bit = uint64_t(1) << 63; bit && !(x & bit); bit >>= 1) ++n;
+        return n;
+#endif
+    }
+
+    // Ertl, "New cardinality estimation algorithms for HyperLogLog sketches"
+    double hllSigma(double x) {
+        if (x == 1.0) return std::numeric_limits<double>::infinity();
+        double y = 1.0;
+        double z = x;
+        double previous;
+        do {
+            x *= x;
+            previous = z;
+            z += x * y;
+            y += y;
+        } while (z != previous);
+        return z;
+    }
+
+    double hllTau(double x) {
+        if (x == 0.0 || x == 1.0) return 0.0;
+        double y = 1.0;
+        double z = 1.0 - x;
+        double previous;
+        do {
+            x = std::sqrt(x);
+            previous = z;
+            y *= 0.5;
+            z -= (1.0 - x) * (1.0 - x) * y;
+        } while (z != previous);
+        return z / 3.0;
+    }
+
+    const uint8_t kHyperLogLogMagic[4] = {'H', 'L', 'L', '1'};
+}
+
+HyperLogLog::HyperLogLog(int precision)
+    : registers_(size_t(1) << std::max(kMinPrecision, std::min(precision, kMaxPrecision)), 0),
+      precision_(std::max(kMinPrecision, std::min(precision, kMaxPrecision))) {}
+
+void HyperLogLog::add(double value) {
+    addMultiple(&value, 1);
+}
+
+void HyperLogLog::addMultiple(const double* values, size_t count) {
+    if (!isEnabled()) return;
+    const int p = precision_;
+    const uint8_t maxRank = static_cast<uint8_t>(64 - p + 1);
+    uint64_t hashes[256];
+    for (size_t block = 0; block < count; block += 256) {
+        const size_t n = std::min<size_t>(256, count - block);
+        // Hashed in a loop of its own, which vectorizes, then scattered
+        #pragma omp simd
+        for (size_t i = 0; i < n; ++i) {
+            hashes[i] = hashDouble(values[block + i]);
+        }
+        for (size_t i = 0; i < n; ++i) {
+            const uint64_t h = hashes[i];
+            const size_t index = static_cast<size_t>(h >> (64 - p));
+            const uint8_t rank = static_cast<uint8_t>(std::min(leadingZeros(h << p) + 1, int(maxRank)));
+            registers_[index] = std::max(registers_[index], rank);
+        }
+    }
+}
+
+void HyperLogLog::clear() {
+    std::fill(registers_.begin(), registers_.end(), 0);
+}
+
+double HyperLogLog::estimate() const {
+    if (!isEnabled()) return 0.0;
+    const int q = 64 - precision_;
+    const double m = static_cast<double>(registers_.size());
+
+    std::vector<size_t> histogram(q + 2, 0);
+    for (uint8_t r : registers_) ++histogram[r];
+
+    double z = m * hllTau(1.0 - histogram[q + 1] / m);
+    for (int k = q; k >= 1; --k) {
+        z = 0.5 * (z + histogram[k]);
+    }
+    z += m * hllSigma(histogram[0] / m);
+    return (0.5 / std::log(2.0)) * m * m / z;
+}
+
+bool HyperLogLog::merge(const HyperLogLog& other) {
+    if (precision_ != other.precision_) return false;
+    for (size_t i = 0; i < registers_.size(); ++i) {
+        registers_[i] = std::max(registers_[i], other.registers_[i]);
+    }
+    return true;
+}
+
+size_t HyperLogLog::serializedSize() const {
+    return sizeof(kHyperLogLogMagic) + 1 + registers_.size();
+}
+
+size_t HyperLogLog::serialize(uint8_t* buffer, size_t size) const {
+    if (buffer == nullptr || size < serializedSize()) return 0;
+    std::memcpy(buffer, kHyperLogLogMagic, sizeof(kHyperLogLogMagic));
+    buffer[sizeof(kHyperLogLogMagic)] = static_cast<uint8_t>(precision_);
+    if (!registers_.empty()) {
+        std::memcpy(buffer + sizeof(kHyperLogLogMagic) + 1, registers_.data(), registers_.size());
+    }
+    return serializedSize();
+}
+
+bool HyperLogLog::deserialize(const uint8_t* buffer, size_t size, HyperLogLog* sketch) {
+    const size_t header = sizeof(kHyperLogLogMagic) + 1;
+    if (buffer == nullptr || sketch == nullptr || size < header ||
+        std::memcmp(buffer, kHyperLogLogMagic, sizeof(kHyperLogLogMagic)) != 0) {
+        return false;
+    }
+    const int precision = buffer[sizeof(kHyperLogLogMagic)];
+    if (precision == 0) {
+        *sketch = HyperLogLog();
+        return size == header;
+    }
+    if (precision < kMinPrecision || precision > kMaxPrecision || size != header + (size_t(1) << precision)) {
+        return false;
+    }
+    HyperLogLog result(precision);
+    const int maxRank = 64 - precision + 1;
+    for (size_t i = 0; i < result.registers_.size(); ++i) {
+        if (buffer[header + i] > maxRank) return false;
+        result.registers_[i] = buffer[header + i];
+    }
+    *sketch = std::move(result);
+    return true;
+}
+
+// MARK: - DataSummary implementation
+
+DataSummary DataSummary::of(const double* values, size_t count) {
+    DataSummary summary;
+    if (count == 0) return summary;
+    summary.count = count;
+    summary.min = values[0];
+    summary.max = values[0];
+    for (size_t i = 0; i < count; ++i) {
+        summary.sum += values[i];
+        summary.min = std::min(summary.min, values[i]);
+        summary.max = std::max(summary.max, values[i]);
+    }
+    const double mean = summary.sum / static_cast<double>(count);
+    for (size_t i = 0; i < count; ++i) {
+        const double diff = values[i] - mean;
+        summary.m2 += diff * diff;
+    }
+    return summary;
+}
+
+void DataSummary::merge(const DataSummary& other) {
+    if (other.count == 0) return;
+    if (count == 0) {
+        *this = other;
+        return;
+    }
+    const double n = static_cast<double>(count + other.count);
+    const double delta = other.sum / other.count - sum / count;
+    m2 += other.m2 + delta * delta * (static_cast<double>(count) * other.count / n);
+    sum += other.sum;
+    min = std::min(min, other.min);
+    max = std::max(max, other.max);
+    count += other.count;
+}
+
+// MARK: - CompressedSeries implementation
+
+namespace {
+    inline int trailingZeros(uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+        return x ? __builtin_ctzll(x) : 64;
+#else
+        int n = 0;
+        for (uint64_t bit = 1; bit && !(x & bit); bit <<= 1) ++n;
+        return n;
+#endif
+    }
+
+    inline uint64_t doubleBits(double value) {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    inline double bitsDouble(uint64_t bits) {
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    class BitWriter {
+    public:
+        explicit BitWriter(std::vector<uint64_t>& words) : words_(words) {}
+
+        // Append the low `count` (1-64) bits of `value`
+        void write(uint64_t value, int count) {
+            if (count < 64) value &= (uint64_t(1) << count) - 1;
+            const int used = static_cast<int>(bits_ & 63);
+            if (used == 0) words_.push_back(0);
+            const int free = 64 - used;
+            if (count <= free) {
+                words_.back() |= value << (free - count);
+            } else {
+                words_.back() |= value >> (count - free);
+                words_.push_back(value << (64 - (count - free)));
+            }
+            bits_ += count;
+        }
+
+    private:
+        std::vector<uint64_t>& words_;
+        size_t bits_ = 0;
+    };
+
+    class BitReader {
+    public:
+        explicit BitReader(const uint64_t* words) : words_(words) {}
+
+        // Next `count` (1-64) bits
+        uint64_t read(int count) {
+            const uint64_t* word = words_ + (bits_ >> 6);
+            const int offset = static_cast<int>(bits_ & 63);
+            const int available = 64 - offset;
+            bits_ += count;
+            if (count <= available) {
+                return (word[0] << offset) >> (64 - count);
+            }
+            const int rest = count - available;
+            return ((word[0] << offset) >> offset << rest) | (word[1] >> (64 - rest));
+        }
+
+    private:
+        const uint64_t* words_;
+        size_t bits_ = 0;
+    };
+
+    // Control bits after the first value of a block, which is stored whole:
+    //   0                       same as the previous value
+    //   10 <bits>               XOR fits in the previous leading/trailing zeros
+    //   11 <6: leading zeros> <6: length - 1> <bits>
+    void gorillaEncode(const double* values, size_t count, std::vector<uint64_t>& words) {
+        BitWriter writer(words);
+        uint64_t previous = doubleBits(values[0]);
+        writer.write(previous, 64);
+        int leading = -1;  // No window yet
+        int trailing = 0;
+        for (size_t i = 1; i < count; ++i) {
+            const uint64_t bits = doubleBits(values[i]);
+            const uint64_t x = bits ^ previous;
+            previous = bits;
+            if (x == 0) {
+                writer.write(0, 1);
+                continue;
+            }
+            const int lz = leadingZeros(x);
+            const int tz = trailingZeros(x);
+            if (leading >= 0 && lz >= leading && tz >= trailing) {
+                writer.write(0b10, 2);
+                writer.write(x >> trailing, 64 - leading - trailing);
+            } else {
+                const int length = 64 - lz - tz;
+                writer.write(0b11, 2);
+                writer.write(static_cast<uint64_t>(lz), 6);
+                writer.write(static_cast<uint64_t>(length - 1), 6);
+                writer.write(x >> tz, length);
+                leading = lz;
+                trailing = tz;
+            }
+        }
+    }
+
+    void gorillaDecode(const uint64_t* words, size_t count, double* values) {
+        if (count == 0) return;
+        BitReader reader(words);
+        uint64_t previous = reader.read(64);
+        values[0] = bitsDouble(previous);
+        int leading = 0;
+        int trailing = 0;
+        for (size_t i = 1; i < count; ++i) {
+            if (reader.read(1) != 0) {
+                if (reader.read(1) != 0) {
+                    leading = static_cast<int>(reader.read(6));
+                    trailing = 64 - leading - static_cast<int>(reader.read(6) + 1);
+                }
+                previous ^= reader.read(64 - leading - trailing) << trailing;
+            }
+            values[i] = bitsDouble(previous);
+        }
+    }
+}
+
+void CompressedSeries::add(double value) {
+    addMultiple(&value, 1);
+}
+
+void CompressedSeries::addMultiple(const double* values, size_t count) {
+    while (count > 0) {
+        if (tail_.capacity() < kBlockSize) tail_.reserve(kBlockSize);
+        const size_t n = std::min(count, kBlockSize - tail_.size());
+        tail_.insert(tail_.end(), values, values + n);
+        values += n;
+        count -= n;
+        if (tail_.size() == kBlockSize) seal();
+    }
+}
+
+void CompressedSeries::seal() {
+    std::vector<uint64_t> words;
+    words.reserve(kBlockSize * 2);  // Worst case is 78 bits a value
+    gorillaEncode(tail_.data(), tail_.size(), words);
+    Block block;
+    block.words.assign(words.begin(), words.end());  // No spare capacity
+    block.summary = DataSummary::of(tail_.data(), tail_.size());
+    blocks_.push_back(std::move(block));
+    tail_.clear();
+}
+
+void CompressedSeries::clear() {
+    blocks_.clear();
+    tail_.clear();
+}
+
+size_t CompressedSeries::getMemoryBytes() const {
+    size_t bytes = blocks_.capacity() * sizeof(Block) + tail_.capacity() * sizeof(double);
+    for (const Block& block : blocks_) {
+        bytes += block.words.capacity() * sizeof(uint64_t);
+    }
+    return bytes;
+}
+
+void CompressedSeries::decode(size_t block, size_t count, double* values) const {
+    gorillaDecode(blocks_[block].words.data(), count, values);
+}
+
+double CompressedSeries::at(size_t index) const {
+    if (index >= size()) return 0.0;
+    const size_t block = index / kBlockSize;
+    if (block == blocks_.size()) return tail_[index % kBlockSize];
+    double values[kBlockSize];
+    decode(block, index % kBlockSize + 1, values);
+    return values[index % kBlockSize];
+}
+
+void CompressedSeries::forEachBlock(size_t begin, size_t end,
+                                    const std::function<void(const double*, size_t)>& visit) const {
+    end = std::min(end, size());
+    double values[kBlockSize];
+    while (begin < end) {
+        const size_t block = begin / kBlockSize;
+        const size_t offset = begin % kBlockSize;
+        const size_t n = std::min(end - begin, kBlockSize - offset);
+        if (block == blocks_.size()) {
+            visit(tail_.data() + offset, n);
+        } else {
+            decode(block, offset + n, values);
+            visit(values + offset, n);
+        }
+        begin += n;
+    }
+}
+
+DataSummary CompressedSeries::summarize(size_t begin, size_t end) const {
+    end = std::min(end, size());
+    DataSummary summary;
+    while (begin < end) {
+        const size_t block = begin / kBlockSize;
+        const size_t offset = begin % kBlockSize;
+        const size_t n = std::min(end - begin, kBlockSize - offset);
+        if (n == kBlockSize) {
+            summary.merge(blocks_[block].summary);
+        } else {
+            forEachBlock(begin, begin + n, [&](const double* values, size_t count) {
+                summary.merge(DataSummary::of(values, count));
+            });
+        }
+        begin += n;
+    }
+    return summary;
+}
+
+// MARK: - ColumnarSnapshot implementation
+
+namespace {
+    // CRC-32 as in zlib, eight bytes at a time (slicing-by-8)
+    struct Crc32Tables {
+        uint32_t table[8][256];
+
+        Crc32Tables() {
+            for (uint32_t i = 0; i < 256; ++i) {
+                uint32_t c = i;
+                for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                table[0][i] = c;
+            }
+            for (uint32_t i = 0; i < 256; ++i) {
+                for (int t = 1; t < 8; ++t) {
+                    table[t][i] = (table[t - 1][i] >> 8) ^ table[0][table[t - 1][i] & 0xff];
+                }
+            }
+        }
+    };
+
+    // Continue `crc` with `size` more bytes
+    uint32_t crc32(const void* data, size_t size, uint32_t crc = 0) {
+        if (size == 0) return crc;  // `data` may be null
+        static const Crc32Tables tables;
+        const auto& t = tables.table;
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+        crc = ~crc;
+        for (; size >= 8; p += 8, size -= 8) {
+            const uint32_t lo = (uint32_t(p[0]) | uint32_t(p[1]) << 8 | uint32_t(p[2]) << 16 | uint32_t(p[3]) << 24) ^ crc;
+            const uint32_t hi = uint32_t(p[4]) | uint32_t(p[5]) << 8 | uint32_t(p[6]) << 16 | uint32_t(p[7]) << 24;
+            crc = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^ t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24] ^
+                  t[3][hi & 0xff] ^ t[2][(hi >> 8) & 0xff] ^ t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+        }
+        for (; size > 0; ++p, --size) {
+            crc = t[0][(crc ^ *p) & 0xff] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+
+    // Snapshot layout, in the byte order of the writer (checked by readers):
+    // header, values, one SnapshotBlock per block, trailer. The trailer CRC
+    // covers the header and the blocks.
+    const char kSnapshotMagic[8] = {'D', 'P', 'S', 'N', 'A', 'P', '0', '1'};
+    const char kSnapshotEndMagic[8] = {'D', 'P', 'S', 'N', 'A', 'P', 'E', 'N'};
+    constexpr uint32_t kSnapshotByteOrder = 0x01020304;
+
+    struct SnapshotHeader {
+        char magic[8];
+        uint32_t byteOrder;
+        uint32_t blockSize;
+        uint64_t count;
+        unsigned char reserved[40];  // Keeps the values 64-byte aligned
+    };
+
+    struct SnapshotBlock {
+        uint64_t count;
+        double sum;
+        double min;
+        double max;
+        double m2;
+        uint32_t crc;  // Of the block's values
+        uint32_t reserved;
+    };
+
+    struct SnapshotTrailer {
+        uint32_t crc;
+        uint32_t reserved;
+        char magic[8];
+    };
+
+    static_assert(sizeof(SnapshotHeader) == 64, "snapshot header layout");
+    static_assert(sizeof(SnapshotBlock) == 48, "snapshot block layout");
+    static_assert(sizeof(SnapshotTrailer) == 16, "snapshot trailer layout");
+
+    // Create a file next to `path` under a name no other writer uses, set
+    // `temporary` to it and return it open for writing, nullptr on failure.
+    // On POSIX the stream wraps the descriptor the file was created with.
+    std::FILE* createSnapshotTemporary(const std::string& path, std::string& temporary) {
+        static std::atomic<uint32_t> sequence{0};
+        std::random_device random;
+        for (int attempt = 0; attempt < 16; ++attempt) {
+            char suffix[32];
+            std::snprintf(suffix, sizeof(suffix), ".%08x%08x.tmp", static_cast<uint32_t>(random()),
+                          static_cast<uint32_t>(sequence++));
+            temporary = path + suffix;
+#if !defined(_WIN32)
+            const int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+            if (fd >= 0) {
+                std::FILE* file = fdopen(fd, "wb");
+                if (file == nullptr) {
+                    ::close(fd);
+                    std::remove(temporary.c_str());
+                }
+                return file;
+            }
+            if (errno != EEXIST) return nullptr;
+#else
+            if (!std::ifstream(temporary)) return std::fopen(temporary.c_str(), "wb");
+#endif
+        }
+        return nullptr;
+    }
+
+    // Flush the directory holding `path`, so a rename into it survives a crash
+    bool syncParentDirectory(const std::string& path) {
+#if !defined(_WIN32)
+        const size_t slash = path.find_last_of('/');
+        const std::string directory = slash == std::string::npos ? "." : path.substr(0, std::max<size_t>(slash, 1));
+        const int fd = ::open(directory.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return false;
+        const bool synced = ::fsync(fd) == 0;
+        ::close(fd);
+        return synced;
+#else
+        (void)path;
+        return true;
+#endif
+    }
+}
+
+ColumnarSnapshot::~ColumnarSnapshot() {
+    close();
+}
+
+void ColumnarSnapshot::close() {
+#if !defined(_WIN32)
+    if (mapping_ != nullptr) munmap(mapping_, mappingSize_);
+#endif
+    mapping_ = nullptr;
+    mappingSize_ = 0;
+    std::vector<double>().swap(buffer_);
+    values_ = nullptr;
+    count_ = 0;
+    blockSize_ = 0;
+    blocks_.clear();
+    checksums_.clear();
+}
+
+bool ColumnarSnapshot::open(const std::string& path) {
+    close();
+#if !defined(_WIN32)
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        struct stat status;
+        if (fstat(fd, &status) == 0 && status.st_size > 0) {
+            void* mapping = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping != MAP_FAILED) {
+                mapping_ = mapping;
+                mappingSize_ = static_cast<size_t>(status.st_size);
+            }
+        }
+        ::close(fd);
+    }
+#endif
+    std::ifstream in;
+    size_t fileSize = mappingSize_;
+    if (mapping_ == nullptr) {
+        in.open(path, std::ios::binary | std::ios::ate);
+        if (!in) return false;
+        fileSize = static_cast<size_t>(in.tellg());
+    }
+    auto read = [&](size_t offset, size_t size, void* destination) {
+        if (offset > fileSize || size > fileSize - offset) return false;
+        if (size == 0) return true;  // `destination` may be null
+        if (mapping_ != nullptr) {
+            std::memcpy(destination, static_cast<const char*>(mapping_) + offset, size);
+            return true;
+        }
+        in.seekg(static_cast<std::streamoff>(offset));
+        in.read(static_cast<char*>(destination), static_cast<std::streamsize>(size));
+        return static_cast<bool>(in);
+    };
+    auto fail = [&] {
+        close();
+        return false;
+    };
+
+    SnapshotHeader header;
+    if (!read(0, sizeof(header), &header) || std::memcmp(header.magic, kSnapshotMagic, sizeof(kSnapshotMagic)) != 0 ||
+        header.byteOrder != kSnapshotByteOrder || header.blockSize == 0) {
+        return fail();
+    }
+    // Check the size before multiplying with the count
+    const size_t available = fileSize - sizeof(SnapshotHeader);
+    if (header.count > available / sizeof(double)) return fail();
+    const size_t count = static_cast<size_t>(header.count);
+    const size_t blockCount = (count + header.blockSize - 1) / header.blockSize;
+    const size_t valuesEnd = sizeof(SnapshotHeader) + count * sizeof(double);
+    if (fileSize != valuesEnd + blockCount * sizeof(SnapshotBlock) + sizeof(SnapshotTrailer)) return fail();
+
+    std::vector<SnapshotBlock> entries(blockCount);
+    SnapshotTrailer trailer;
+    if (!read(valuesEnd, entries.size() * sizeof(SnapshotBlock), entries.data()) ||
+        !read(fileSize - sizeof(trailer), sizeof(trailer), &trailer) ||
+        std::memcmp(trailer.magic, kSnapshotEndMagic, sizeof(kSnapshotEndMagic)) != 0 ||
+        trailer.crc != crc32(entries.data(), entries.size() * sizeof(SnapshotBlock), crc32(&header, sizeof(header)))) {
+        return fail();
+    }
+    blocks_.resize(blockCount);
+    checksums_.resize(blockCount);
+    for (size_t b = 0; b < blockCount; ++b) {
+        const size_t expected = std::min<size_t>(header.blockSize, count - b * header.blockSize);
+        if (entries[b].count != expected) return fail();
+        blocks_[b] = DataSummary{expected, entries[b].sum, entries[b].min, entries[b].max, entries[b].m2};
+        checksums_[b] = entries[b].crc;
+    }
+
+    if (mapping_ != nullptr) {
+        values_ = reinterpret_cast<const double*>(static_cast<const char*>(mapping_) + sizeof(SnapshotHeader));
+    } else {
+        buffer_.resize(count);
+        if (!read(sizeof(SnapshotHeader), count * sizeof(double), buffer_.data())) return fail();
+        values_ = buffer_.data();
+    }
+    count_ = count;
+    blockSize_ = header.blockSize;
+    return true;
+}
+
+DataSummary ColumnarSnapshot::summarize(size_t begin, size_t end) const {
+    end = std::min(end, count_);
+    DataSummary summary;
+    while (begin < end) {
+        const size_t block = begin / blockSize_;
+        const size_t n = std::min(end - begin, blockSize_ - begin % blockSize_);
+        summary.merge(n == blocks_[block].count ? blocks_[block] : DataSummary::of(values_ + begin, n));
+        begin += n;
+    }
+    return summary;
+}
+
+bool ColumnarSnapshot::verify() const {
+    for (size_t b = 0; b < blocks_.size(); ++b) {
+        if (crc32(values_ + b * blockSize_, blocks_[b].count * sizeof(double)) != checksums_[b]) return false;
+    }
+    return isOpen();
+}
+
+bool ColumnarSnapshot::write(const std::string& path, size_t count,
+                             const std::function<void(const std::function<void(const double*, size_t)>&)>& forEachRun) {
+    // Written aside under a unique name, synced and renamed over `path`, so
+    // that concurrent writers do not collide and that readers, mappings of
+    // the previous file and a crash never leave a partial one
+    std::string temporary;
+    std::FILE* out = createSnapshotTemporary(path, temporary);
+    if (out == nullptr) return false;
+    bool complete = true;
+    auto put = [&](const void* data, size_t size) {
+        if (size != 0 && std::fwrite(data, 1, size, out) != size) complete = false;
+    };
+
+    SnapshotHeader header{};
+    std::memcpy(header.magic, kSnapshotMagic, sizeof(kSnapshotMagic));
+    header.byteOrder = kSnapshotByteOrder;
+    header.blockSize = static_cast<uint32_t>(kBlockSize);
+    header.count = count;
+    put(&header, sizeof(header));
+
+    std::vector<DataSummary> summaries((count + kBlockSize - 1) / kBlockSize);
+    std::vector<uint32_t> checksums(summaries.size(), 0);
+    size_t written = 0;
+    forEachRun([&](const double* values, size_t n) {
+        n = std::min(n, count - written);
+        put(values, n * sizeof(double));
+        while (n > 0) {
+            const size_t block = written / kBlockSize;
+            const size_t take = std::min(n, kBlockSize - written % kBlockSize);
+            summaries[block].merge(DataSummary::of(values, take));
+            checksums[block] = crc32(values, take * sizeof(double), checksums[block]);
+            values += take;
+            n -= take;
+            written += take;
+        }
+    });
+
+    std::vector<SnapshotBlock> entries(summaries.size());
+    for (size_t b = 0; b < entries.size(); ++b) {
+        const DataSummary& summary = summaries[b];
+        entries[b] = SnapshotBlock{summary.count, summary.sum, summary.min, summary.max, summary.m2, checksums[b], 0};
+    }
+    SnapshotTrailer trailer{};
+    trailer.crc = crc32(entries.data(), entries.size() * sizeof(SnapshotBlock), crc32(&header, sizeof(header)));
+    std::memcpy(trailer.magic, kSnapshotEndMagic, sizeof(kSnapshotEndMagic));
+    put(entries.data(), entries.size() * sizeof(SnapshotBlock));
+    put(&trailer, sizeof(trailer));
+
+    bool saved = complete && written == count && std::fflush(out) == 0;
+#if !defined(_WIN32)
+    saved = saved && ::fsync(fileno(out)) == 0;
+#endif
+    saved = std::fclose(out) == 0 && saved;
+    if (!saved || std::rename(temporary.c_str(), path.c_str()) != 0) {
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return syncParentDirectory(path);
+}
+
 // MARK: - DataProcessor implementation
 
 DataProcessor::DataProcessor(const std::string& name) : name_(name) {
@@ -175,45 +1335,73 @@ DataProcessor::DataProcessor(const std::string& name) : name_(name) {
 }
 
 void DataProcessor::addData(double value) {
-    data_.push_back(value);
+    detachSnapshot();
+    if (compressed_) {
+        compressedData_.add(value);
+    } else {
+        data_.push_back(value);
+    }
+    distinct_.add(value);
 }
 
 void DataProcessor::addMultipleData(const double* values, size_t count) {
-    for (size_t i = 0; i < count; ++i) {
-        data_.push_back(values[i]);
+    detachSnapshot();
+    if (compressed_) {
+        compressedData_.addMultiple(values, count);
+    } else {
+        for (size_t i = 0; i < count; ++i) {
+            data_.push_back(values[i]);
+        }
     }
+    distinct_.addMultiple(values, count);
     std::cout << "C++: Added " << count << " values to DataProcessor" << std::endl;
 }
 
 void DataProcessor::clearData() {
     data_.clear();
+    resetRangeIndex();
+    distinct_.clear();
+    compressedData_.clear();
+    snapshot_.reset();
     std::cout << "C++: DataProcessor data cleared" << std::endl;
 }
 
 size_t DataProcessor::getDataCount() const {
-    return data_.size();
+    if (snapshot_) return snapshot_->size();
+    return compressed_ ? compressedData_.size() : data_.size();
 }
 
 double DataProcessor::getSum() const {
+    DataSummary summary;
+    if (summarizeBlocks(0, getDataCount(), &summary)) return summary.sum;
     return std::accumulate(data_.begin(), data_.end(), 0.0);
 }
 
 double DataProcessor::getAverage() const {
-    if (data_.empty()) return 0.0;
-    return getSum() / data_.size();
+    if (getDataCount() == 0) return 0.0;
+    return getSum() / getDataCount();
 }
 
 double DataProcessor::getMin() const {
+    DataSummary summary;
+    if (summarizeBlocks(0, getDataCount(), &summary)) return summary.min;
     if (data_.empty()) return 0.0;
     return *std::min_element(data_.begin(), data_.end());
 }
 
 double DataProcessor::getMax() const {
+    DataSummary summary;
+    if (summarizeBlocks(0, getDataCount(), &summary)) return summary.max;
     if (data_.empty()) return 0.0;
     return *std::max_element(data_.begin(), data_.end());
 }
 
 double DataProcessor::getStandardDeviation() const {
+    DataSummary summary;
+    if (summarizeBlocks(0, getDataCount(), &summary)) {
+        if (summary.count < 2) return 0.0;
+        return std::sqrt(summary.m2 / (summary.count - 1));
+    }
     if (data_.size() < 2) return 0.0;
     
     double mean = getAverage();
@@ -228,6 +1416,8 @@ double DataProcessor::getStandardDeviation() const {
 }
 
 double DataProcessor::getDataAtIndex(size_t index) const {
+    if (snapshot_) return index < snapshot_->size() ? snapshot_->values()[index] : 0.0;
+    if (compressed_) return compressedData_.at(index);
     if (index < data_.size()) {
         return data_[index];
     }
@@ -237,11 +1427,613 @@ double DataProcessor::getDataAtIndex(size_t index) const {
 void DataProcessor::printStatistics() const {
     std::cout << "C++: DataProcessor '" << name_ << "' Statistics:" << std::endl;
     std::cout << "  Count: " << getDataCount() << std::endl;
-    std::cout << "  Sum: " << getSum() << std::endl;
-    std::cout << "  Average: " << getAverage() << std::endl;
-    std::cout << "  Min: " << getMin() << std::endl;
-    std::cout << "  Max: " << getMax() << std::endl;
-    std::cout << "  Std Dev: " << getStandardDeviation() << std::endl;
+    std::cout << "  Sum: " << shortest(getSum()) << std::endl;
+    std::cout << "  Average: " << shortest(getAverage()) << std::endl;
+    std::cout << "  Min: " << shortest(getMin()) << std::endl;
+    std::cout << "  Max: " << shortest(getMax()) << std::endl;
+    std::cout << "  Std Dev: " << shortest(getStandardDeviation()) << std::endl;
+}
+
+namespace {
+    // Values binned per block: indices are computed for a whole block first,
+    // in branch-free loops of a fixed trip count that vectorize at -O2, then
+    // counted in a separate scalar pass
+    constexpr size_t kHistogramBlock = 1024;
+    // Below this many values a single thread is faster than starting more
+    constexpr size_t kHistogramValuesPerThread = 1 << 18;
+    // Up to this many interior edges, counting the edges below each value
+    // over the whole block beats a binary search, whose loads are gathers
+    constexpr size_t kHistogramLinearEdges = 16;
+
+    // The `n` values at `values` as a whole block: in place when full,
+    // else copied into `block` and padded with NaNs, which bin outside
+    const double* histogramBlock(const double* values, size_t n, double* block) {
+        if (n == kHistogramBlock) return values;
+        std::copy(values, values + n, block);
+        std::fill(block + n, block + kHistogramBlock, std::numeric_limits<double>::quiet_NaN());
+        return block;
+    }
+
+    // Count values[begin, end) into counts[0, bins]; the extra last slot
+    // collects the values outside the range
+    void histogramRange(const double* values, size_t begin, size_t end, size_t bins,
+                        double lo, double hi, size_t* counts) {
+        const double scale = static_cast<double>(bins) / (hi - lo);
+        const double last = static_cast<double>(bins - 1);
+        const double outside = static_cast<double>(bins);
+        double padded[kHistogramBlock];
+        int32_t indices[kHistogramBlock];
+        for (size_t block = begin; block < end; block += kHistogramBlock) {
+            const size_t n = std::min(kHistogramBlock, end - block);
+            const double* v = histogramBlock(values + block, n, padded);
+            #pragma omp simd
+            for (size_t i = 0; i < kHistogramBlock; ++i) {
+                const bool inside = (v[i] >= lo) & (v[i] <= hi);  // false for NaN
+                const double t = (v[i] - lo) * scale;
+                const double bin = t < last ? t : last;  // hi, and rounding just below it
+                indices[i] = static_cast<int32_t>(inside ? bin : outside);
+            }
+            for (size_t i = 0; i < n; ++i) {
+                ++counts[indices[i]];
+            }
+        }
+    }
+
+    // Count values[begin, end) into counts[0, bins] against the interior
+    // edges in `padded`, a power-of-two sized array ending in at least one
+    // +infinity. The bin is the number of interior edges <= v.
+    void histogramEdgesRange(const double* values, size_t begin, size_t end, size_t bins,
+                             double lo, double hi, const std::vector<double>& padded, size_t* counts) {
+        const double* edges = padded.data();
+        const size_t interior = bins - 1;
+        const double outside = static_cast<double>(bins);
+        const double below = -std::numeric_limits<double>::infinity();
+        double block[kHistogramBlock];
+        double clamped[kHistogramBlock];
+        double position[kHistogramBlock];
+        int32_t indices[kHistogramBlock];
+        for (size_t start = begin; start < end; start += kHistogramBlock) {
+            const size_t n = std::min(kHistogramBlock, end - start);
+            const double* v = histogramBlock(values + start, n, block);
+            // Values outside [lo, hi] start in the out-of-range slot and, as
+            // -infinity, pass no edge
+            #pragma omp simd
+            for (size_t i = 0; i < kHistogramBlock; ++i) {
+                const bool inside = (v[i] >= lo) & (v[i] <= hi);
+                clamped[i] = inside ? v[i] : below;
+                position[i] = inside ? 0.0 : outside;
+            }
+            if (interior <= kHistogramLinearEdges) {
+                for (size_t e = 0; e < interior; ++e) {
+                    const double edge = edges[e];
+                    #pragma omp simd
+                    for (size_t i = 0; i < kHistogramBlock; ++i) {
+                        position[i] += edge <= clamped[i] ? 1.0 : 0.0;
+                    }
+                }
+                #pragma omp simd
+                for (size_t i = 0; i < kHistogramBlock; ++i) {
+                    indices[i] = static_cast<int32_t>(position[i]);
+                }
+            } else {
+                // Branch-free binary search run level by level over the block
+                std::fill(indices, indices + kHistogramBlock, 0);
+                for (size_t step = padded.size() / 2; step > 0; step /= 2) {
+                    const int32_t offset = static_cast<int32_t>(step);
+                    for (size_t i = 0; i < kHistogramBlock; ++i) {
+                        indices[i] += edges[indices[i] + offset - 1] <= clamped[i] ? offset : 0;
+                    }
+                }
+                #pragma omp simd
+                for (size_t i = 0; i < kHistogramBlock; ++i) {
+                    indices[i] += static_cast<int32_t>(position[i]);
+                }
+            }
+            for (size_t i = 0; i < n; ++i) {
+                ++counts[indices[i]];
+            }
+        }
+    }
+
+    bool isValidHistogram(size_t bins, double lo, double hi, const size_t* counts) {
+        return bins != 0 && bins <= std::numeric_limits<int32_t>::max() - 1 && counts != nullptr && lo < hi &&
+               std::isfinite(hi - lo);
+    }
+
+    // Run `count` over the data split between threads, each with its own
+    // counts, and add them up into `counts[0, bins)`
+    template <typename Count>
+    void histogramParallel(size_t size, size_t bins, size_t* counts, Count count) {
+        size_t threads = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()),
+                                          size / kHistogramValuesPerThread);
+        threads = std::max<size_t>(threads, 1);
+
+        std::vector<size_t> partial(threads * (bins + 1), 0);
+        std::vector<std::thread> workers;
+        const size_t chunk = (size + threads - 1) / threads;
+        for (size_t t = 1; t < threads; ++t) {
+            workers.emplace_back([&, t] {
+                count(t * chunk, std::min(size, (t + 1) * chunk), partial.data() + t * (bins + 1));
+            });
+        }
+        count(0, std::min(size, chunk), partial.data());
+        for (auto& worker : workers) worker.join();
+
+        std::fill(counts, counts + bins, 0);
+        for (size_t t = 0; t < threads; ++t) {
+            const size_t* sub = partial.data() + t * (bins + 1);
+            for (size_t b = 0; b < bins; ++b) counts[b] += sub[b];
+        }
+    }
+}
+
+bool DataProcessor::histogram(size_t bins, double lo, double hi, size_t* counts) const {
+    if (!isValidHistogram(bins, lo, hi, counts)) return false;
+    histogramParallel(getDataCount(), bins, counts, [&](size_t begin, size_t end, size_t* sub) {
+        forEachBlock(begin, end, [&](const double* values, size_t count) {
+            histogramRange(values, 0, count, bins, lo, hi, sub);
+        });
+    });
+    return true;
+}
+
+bool DataProcessor::histogram(const double* edges, size_t edgeCount, size_t* counts) const {
+    if (edges == nullptr || edgeCount < 2 || edgeCount - 1 > (size_t(1) << 30) ||
+        counts == nullptr || !std::all_of(edges, edges + edgeCount, [](double e) { return std::isfinite(e); }) ||
+        !std::is_sorted(edges, edges + edgeCount) || !(edges[0] < edges[edgeCount - 1])) {
+        return false;
+    }
+    const size_t bins = edgeCount - 1;
+    const double lo = edges[0];
+    const double hi = edges[bins];
+
+    // Interior edges, padded with +infinity to a power of two of at least
+    // bins + 1 so the search never reads past the end. Values equal to hi
+    // pass every interior edge and land in the last bin
+    size_t size = 1;
+    while (size < bins + 1) size *= 2;
+    std::vector<double> padded(size, std::numeric_limits<double>::infinity());
+    std::copy(edges + 1, edges + bins, padded.begin());
+
+    histogramParallel(getDataCount(), bins, counts, [&](size_t begin, size_t end, size_t* sub) {
+        forEachBlock(begin, end, [&](const double* values, size_t count) {
+            histogramEdgesRange(values, 0, count, bins, lo, hi, padded, sub);
+        });
+    });
+    return true;
+}
+
+void DataProcessor::updateRangeIndex() const {
+    const size_t n = data_.size();
+    if (indexedCount_ == n) return;
+    const size_t from = indexedCount_;
+
+    // Neumaier-compensated prefix sums, continued from the last indexed value
+    if (prefixSums_.empty()) {
+        prefixSums_.push_back(0.0);
+        prefixCompensations_.push_back(0.0);
+    }
+    prefixSums_.resize(n + 1);
+    prefixCompensations_.resize(n + 1);
+    double sum = prefixSums_[from];
+    double compensation = prefixCompensations_[from];
+    for (size_t i = from; i < n; ++i) {
+        const double value = data_[i];
+        const double next = sum + value;
+        compensation += std::fabs(sum) >= std::fabs(value) ? (sum - next) + value : (value - next) + sum;
+        sum = next;
+        prefixSums_[i + 1] = sum;
+        prefixCompensations_[i + 1] = compensation;
+    }
+
+    // Extremes of the complete blocks, then sparse tables over them: entries
+    // only ever get appended, as those covering earlier blocks cannot change
+    if (minTable_.empty()) {
+        minTable_.emplace_back();
+        maxTable_.emplace_back();
+    }
+    const size_t blocks = n / kRangeIndexBlock;
+    for (size_t b = minTable_[0].size(); b < blocks; ++b) {
+        const auto first = data_.begin() + b * kRangeIndexBlock;
+        const auto extremes = std::minmax_element(first, first + kRangeIndexBlock);
+        minTable_[0].push_back(*extremes.first);
+        maxTable_[0].push_back(*extremes.second);
+    }
+    for (size_t k = 1; (size_t(1) << k) <= blocks; ++k) {
+        const size_t half = size_t(1) << (k - 1);
+        if (minTable_.size() <= k) {
+            minTable_.emplace_back();
+            maxTable_.emplace_back();
+        }
+        const std::vector<double>& lowerMins = minTable_[k - 1];
+        const std::vector<double>& lowerMaxs = maxTable_[k - 1];
+        std::vector<double>& mins = minTable_[k];
+        std::vector<double>& maxs = maxTable_[k];
+        const size_t oldSize = mins.size();
+        const size_t newSize = blocks - 2 * half + 1;
+        mins.resize(newSize);
+        maxs.resize(newSize);
+        for (size_t i = oldSize; i < newSize; ++i) {
+            mins[i] = std::min(lowerMins[i], lowerMins[i + half]);
+            maxs[i] = std::max(lowerMaxs[i], lowerMaxs[i + half]);
+        }
+    }
+    indexedCount_ = n;
+}
+
+void DataProcessor::enableDistinctCount(int precision) {
+    distinct_ = HyperLogLog(precision);
+    forEachBlock(0, getDataCount(), [&](const double* values, size_t count) {
+        distinct_.addMultiple(values, count);
+    });
+}
+
+void DataProcessor::forEachBlock(size_t begin, size_t end,
+                                 const std::function<void(const double*, size_t)>& visit) const {
+    if (compressed_) {
+        compressedData_.forEachBlock(begin, end, visit);
+        return;
+    }
+    const double* values = snapshot_ ? snapshot_->values() : data_.data();
+    end = std::min(end, getDataCount());
+    if (begin < end) visit(values + begin, end - begin);
+}
+
+bool DataProcessor::summarizeBlocks(size_t begin, size_t end, DataSummary* summary) const {
+    if (snapshot_) {
+        *summary = snapshot_->summarize(begin, end);
+        return true;
+    }
+    if (compressed_) {
+        *summary = compressedData_.summarize(begin, end);
+        return true;
+    }
+    return false;
+}
+
+void DataProcessor::resetRangeIndex() {
+    indexedCount_ = 0;
+    std::vector<double>().swap(prefixSums_);
+    std::vector<double>().swap(prefixCompensations_);
+    std::vector<std::vector<double>>().swap(minTable_);
+    std::vector<std::vector<double>>().swap(maxTable_);
+}
+
+void DataProcessor::detachSnapshot() {
+    if (!snapshot_) return;
+    data_.assign(snapshot_->values(), snapshot_->values() + snapshot_->size());
+    snapshot_.reset();
+}
+
+void DataProcessor::enableCompressedStorage() {
+    if (compressed_) return;
+    forEachBlock(0, getDataCount(), [&](const double* values, size_t count) {
+        compressedData_.addMultiple(values, count);
+    });
+    compressed_ = true;
+    // Drop the memory of both along with the values
+    std::vector<double>().swap(data_);
+    snapshot_.reset();
+    resetRangeIndex();
+}
+
+size_t DataProcessor::getStorageBytes() const {
+    if (snapshot_) return snapshot_->isMapped() ? 0 : snapshot_->size() * sizeof(double);
+    return compressed_ ? compressedData_.getMemoryBytes() : data_.capacity() * sizeof(double);
+}
+
+DataPipeline DataProcessor::pipeline() const {
+    return DataPipeline(*this);
+}
+
+bool DataProcessor::save(const std::string& path) const {
+    const size_t count = getDataCount();
+    const bool saved = ColumnarSnapshot::write(path, count, [&](const std::function<void(const double*, size_t)>& visit) {
+        forEachBlock(0, count, visit);
+    });
+    if (saved) {
+        std::cout << "C++: DataProcessor '" << name_ << "' saved " << count << " values to " << path << std::endl;
+    }
+    return saved;
+}
+
+bool DataProcessor::load(const std::string& path, bool verifyChecksums) {
+    auto snapshot = std::make_shared<ColumnarSnapshot>();
+    if (!snapshot->open(path) || (verifyChecksums && !snapshot->verify())) {
+        return false;
+    }
+    std::vector<double>().swap(data_);
+    compressed_ = false;
+    compressedData_.clear();
+    resetRangeIndex();
+    snapshot_ = std::move(snapshot);
+    if (distinct_.isEnabled()) {
+        distinct_.clear();
+        forEachBlock(0, getDataCount(), [&](const double* values, size_t count) {
+            distinct_.addMultiple(values, count);
+        });
+    }
+    std::cout << "C++: DataProcessor '" << name_ << "' loaded " << snapshot_->size() << " values from " << path << std::endl;
+    return true;
+}
+
+double DataProcessor::getRangeSum(size_t begin, size_t end) const {
+    DataSummary summary;
+    if (summarizeBlocks(begin, end, &summary)) return summary.sum;
+    end = std::min(end, data_.size());
+    if (begin >= end) return 0.0;
+    updateRangeIndex();
+    return (prefixSums_[end] - prefixSums_[begin]) + (prefixCompensations_[end] - prefixCompensations_[begin]);
+}
+
+double DataProcessor::getRangeAverage(size_t begin, size_t end) const {
+    end = std::min(end, getDataCount());
+    if (begin >= end) return 0.0;
+    return getRangeSum(begin, end) / static_cast<double>(end - begin);
+}
+
+namespace {
+    // Level of the two overlapping sparse table intervals covering [begin, end)
+    size_t sparseTableLevel(size_t length) {
+        size_t k = 0;
+        while ((size_t(2) << k) <= length) ++k;
+        return k;
+    }
+
+    // Combine with `pick` the values of [begin, end): the partial blocks at
+    // both ends from `data`, the complete blocks between from `table`
+    template <typename Pick>
+    double rangeExtreme(const std::vector<double>& data, const std::vector<std::vector<double>>& table,
+                        size_t block, size_t begin, size_t end, Pick pick) {
+        const size_t firstBlock = (begin + block - 1) / block;
+        const size_t lastBlock = std::min(end / block, table[0].size());
+        double result = data[begin];
+        if (firstBlock >= lastBlock) {
+            for (size_t i = begin; i < end; ++i) result = pick(result, data[i]);
+            return result;
+        }
+        for (size_t i = begin; i < firstBlock * block; ++i) result = pick(result, data[i]);
+        for (size_t i = lastBlock * block; i < end; ++i) result = pick(result, data[i]);
+        const size_t k = sparseTableLevel(lastBlock - firstBlock);
+        return pick(result, pick(table[k][firstBlock], table[k][lastBlock - (size_t(1) << k)]));
+    }
+}
+
+double DataProcessor::getRangeMin(size_t begin, size_t end) const {
+    DataSummary summary;
+    if (summarizeBlocks(begin, end, &summary)) return summary.min;
+    end = std::min(end, data_.size());
+    if (begin >= end) return 0.0;
+    updateRangeIndex();
+    return rangeExtreme(data_, minTable_, kRangeIndexBlock, begin, end,
+                        [](double a, double b) { return std::min(a, b); });
+}
+
+double DataProcessor::getRangeMax(size_t begin, size_t end) const {
+    DataSummary summary;
+    if (summarizeBlocks(begin, end, &summary)) return summary.max;
+    end = std::min(end, data_.size());
+    if (begin >= end) return 0.0;
+    updateRangeIndex();
+    return rangeExtreme(data_, maxTable_, kRangeIndexBlock, begin, end,
+                        [](double a, double b) { return std::max(a, b); });
+}
+
+// MARK: - DataPipeline implementation
+
+namespace {
+    // Steps run over whole chunks with select predication: a filter clears
+    // the mask lanes it rejects, and a map applies to every lane, filtered
+    // or not, since what filtered lanes turn into is ignored. Masks are all
+    // ones or zero, so consumers drop filtered lanes with a bitwise and
+    // rather than a branch. The loops have a fixed trip count and no
+    // branches, so they vectorize at -O2, except Log and Exp, which call
+    // libm for each lane.
+    constexpr size_t kPipelineChunk = DataPipeline::kChunkSize;
+
+    template <typename Keep>
+    void filterChunk(const double* v, uint64_t* mask, Keep keep) {
+        #pragma omp simd
+        for (size_t i = 0; i < kPipelineChunk; ++i) {
+            mask[i] = keep(v[i]) ? mask[i] : 0;
+        }
+    }
+
+    template <typename Apply>
+    void mapChunk(double* v, Apply apply) {
+        #pragma omp simd
+        for (size_t i = 0; i < kPipelineChunk; ++i) {
+            v[i] = apply(v[i]);
+        }
+    }
+
+    void applyFilter(PipelineFilter filter, double c, const double* v, uint64_t* mask) {
+        switch (filter) {
+            case PipelineFilter::Greater:      filterChunk(v, mask, [c](double x) { return x > c; }); break;
+            case PipelineFilter::GreaterEqual: filterChunk(v, mask, [c](double x) { return x >= c; }); break;
+            case PipelineFilter::Less:         filterChunk(v, mask, [c](double x) { return x < c; }); break;
+            case PipelineFilter::LessEqual:    filterChunk(v, mask, [c](double x) { return x <= c; }); break;
+            case PipelineFilter::Equal:        filterChunk(v, mask, [c](double x) { return x == c; }); break;
+            case PipelineFilter::NotEqual:     filterChunk(v, mask, [c](double x) { return x != c; }); break;
+            // inf - inf and NaN - NaN are NaN
+            case PipelineFilter::Finite:       filterChunk(v, mask, [](double x) { return x - x == 0.0; }); break;
+        }
+    }
+
+    void applyMap(PipelineMap map, double c, double* v) {
+        switch (map) {
+            case PipelineMap::Add:      mapChunk(v, [c](double x) { return x + c; }); break;
+            case PipelineMap::Multiply: mapChunk(v, [c](double x) { return x * c; }); break;
+            case PipelineMap::Min:      mapChunk(v, [c](double x) { return x < c ? x : c; }); break;
+            case PipelineMap::Max:      mapChunk(v, [c](double x) { return x > c ? x : c; }); break;
+            case PipelineMap::Abs:      mapChunk(v, [](double x) { return std::fabs(x); }); break;
+            case PipelineMap::Negate:   mapChunk(v, [](double x) { return -x; }); break;
+            case PipelineMap::Square:   mapChunk(v, [](double x) { return x * x; }); break;
+            case PipelineMap::Sqrt:     mapChunk(v, [](double x) { return std::sqrt(x); }); break;
+            case PipelineMap::Log:      mapChunk(v, [](double x) { return std::log(x); }); break;
+            case PipelineMap::Exp:      mapChunk(v, [](double x) { return std::exp(x); }); break;
+        }
+    }
+
+    DataSummary maskedSummary(const double* v, const uint64_t* mask) {
+        DataSummary summary;
+        const uint64_t above = doubleBits(std::numeric_limits<double>::infinity());
+        const uint64_t below = doubleBits(-std::numeric_limits<double>::infinity());
+        uint64_t count = 0;
+        double sum = 0.0;
+        double min = std::numeric_limits<double>::infinity();
+        double max = -std::numeric_limits<double>::infinity();
+        #pragma omp simd reduction(+ : count, sum) reduction(min : min) reduction(max : max)
+        for (size_t i = 0; i < kPipelineChunk; ++i) {
+            // Filtered lanes add 0.0, and are +-infinity for min and max
+            const uint64_t value = doubleBits(v[i]) & mask[i];
+            count += mask[i] & 1;
+            sum += bitsDouble(value);
+            const double low = bitsDouble(value | (above & ~mask[i]));
+            const double high = bitsDouble(value | (below & ~mask[i]));
+            min = low < min ? low : min;
+            max = high > max ? high : max;
+        }
+        if (count == 0) return summary;
+        const double mean = sum / static_cast<double>(count);
+        double m2 = 0.0;
+        #pragma omp simd reduction(+ : m2)
+        for (size_t i = 0; i < kPipelineChunk; ++i) {
+            const double diff = v[i] - mean;
+            m2 += bitsDouble(doubleBits(diff * diff) & mask[i]);
+        }
+        summary.count = count;
+        summary.sum = sum;
+        summary.min = min;
+        summary.max = max;
+        summary.m2 = m2;
+        return summary;
+    }
+
+    // Unsigned keys in the order of the doubles, -0.0 before 0.0
+    inline uint64_t orderedKey(double value) {
+        const uint64_t bits = doubleBits(value);
+        return (bits >> 63) ? ~bits : bits | (uint64_t(1) << 63);
+    }
+
+    inline double keyValue(uint64_t key) {
+        return bitsDouble((key >> 63) ? key & ~(uint64_t(1) << 63) : ~key);
+    }
+
+    // Candidates for a quantile are collected and selected from directly
+    // once there are this few of them
+    constexpr size_t kQuantileCollect = 1 << 16;
+    constexpr int kQuantileRadixBits = 16;
+}
+
+DataPipeline DataPipeline::filter(PipelineFilter filter, double operand) const {
+    DataPipeline pipeline(*this);
+    pipeline.steps_.push_back(Step{true, filter, PipelineMap::Add, operand});
+    return pipeline;
+}
+
+DataPipeline DataPipeline::map(PipelineMap map, double operand) const {
+    DataPipeline pipeline(*this);
+    pipeline.steps_.push_back(Step{false, PipelineFilter::Finite, map, operand});
+    return pipeline;
+}
+
+void DataPipeline::run(size_t begin, size_t end,
+                       const std::function<void(double*, const uint64_t*, size_t)>& consume) const {
+    double values[kChunkSize];
+    uint64_t mask[kChunkSize];
+    source_->forEachBlock(begin, end, [&](const double* run, size_t count) {
+        for (size_t offset = 0; offset < count; offset += kChunkSize) {
+            const size_t n = std::min(kChunkSize, count - offset);
+            std::copy(run + offset, run + offset + n, values);
+            std::fill(values + n, values + kChunkSize, 0.0);
+            std::fill(mask, mask + n, ~uint64_t(0));
+            std::fill(mask + n, mask + kChunkSize, uint64_t(0));
+            for (const Step& step : steps_) {
+                if (step.isFilter) {
+                    applyFilter(step.filter, step.operand, values, mask);
+                } else {
+                    applyMap(step.map, step.operand, values);
+                }
+            }
+            consume(values, mask, n);
+        }
+    });
+}
+
+DataSummary DataPipeline::stats() const {
+    DataSummary summary;
+    run(0, source_->getDataCount(), [&](double* values, const uint64_t* mask, size_t) {
+        summary.merge(maskedSummary(values, mask));
+    });
+    return summary;
+}
+
+bool DataPipeline::histogram(size_t bins, double lo, double hi, size_t* counts) const {
+    if (!isValidHistogram(bins, lo, hi, counts)) return false;
+    const uint64_t outside = doubleBits(std::numeric_limits<double>::quiet_NaN());
+    histogramParallel(source_->getDataCount(), bins, counts, [&](size_t begin, size_t end, size_t* sub) {
+        run(begin, end, [&](double* values, const uint64_t* mask, size_t n) {
+            #pragma omp simd
+            for (size_t i = 0; i < kChunkSize; ++i) {
+                // Not counted, like NaNs
+                values[i] = bitsDouble((doubleBits(values[i]) & mask[i]) | (outside & ~mask[i]));
+            }
+            histogramRange(values, 0, n, bins, lo, hi, sub);
+        });
+    });
+    return true;
+}
+
+double DataPipeline::quantile(double q) const {
+    if (!(q >= 0.0 && q <= 1.0)) return 0.0;
+    const size_t size = source_->getDataCount();
+
+    // Each pass counts the candidates, the passing values whose keys start
+    // with the `known` bits of `prefix`, by their next 16 bits, and narrows
+    // them down to the bucket holding the rank
+    uint64_t prefix = 0;
+    int known = 0;
+    size_t rank = 0;
+    size_t candidates = 0;
+    auto isCandidate = [&](double value) {
+        return value == value && (known == 0 || (orderedKey(value) >> (64 - known)) == prefix);
+    };
+    std::vector<size_t> buckets(size_t(1) << kQuantileRadixBits);
+    while (known < 64) {
+        if (known > 0 && candidates <= kQuantileCollect) {
+            std::vector<uint64_t> keys;
+            keys.reserve(candidates);
+            run(0, size, [&](double* values, const uint64_t* mask, size_t n) {
+                for (size_t i = 0; i < n; ++i) {
+                    if (mask[i] && isCandidate(values[i])) keys.push_back(orderedKey(values[i]));
+                }
+            });
+            std::nth_element(keys.begin(), keys.begin() + rank, keys.end());
+            return keyValue(keys[rank]);
+        }
+
+        std::fill(buckets.begin(), buckets.end(), 0);
+        const int shift = 64 - known - kQuantileRadixBits;
+        run(0, size, [&](double* values, const uint64_t* mask, size_t n) {
+            for (size_t i = 0; i < n; ++i) {
+                if (mask[i] && isCandidate(values[i])) {
+                    ++buckets[(orderedKey(values[i]) >> shift) & (buckets.size() - 1)];
+                }
+            }
+        });
+        if (known == 0) {
+            const size_t total = std::accumulate(buckets.begin(), buckets.end(), size_t(0));
+            if (total == 0) return 0.0;
+            rank = static_cast<size_t>(std::floor(q * static_cast<double>(total - 1)));
+        }
+        size_t bucket = 0;
+        while (rank >= buckets[bucket]) rank -= buckets[bucket++];
+        candidates = buckets[bucket];
+        prefix = (prefix << kQuantileRadixBits) | bucket;
+        known += kQuantileRadixBits;
+    }
+    return keyValue(prefix);
 }
 
 // MARK: - Timer implementation
@@ -276,7 +2068,93 @@ double Timer::getElapsedSeconds() const {
 }
 
 void Timer::printElapsed() const {
-    std::cout << "C++: Elapsed time: " << getElapsedMilliseconds() << " ms" << std::endl;
+    std::cout << "C++: Elapsed time: " << shortest(getElapsedMilliseconds()) << " ms" << std::endl;
+}
+
+// MARK: - Timestamp implementation
+
+namespace Timestamp {
+    namespace {
+        struct SecondCache {
+            long long second = std::numeric_limits<long long>::min();
+            char prefix[24];
+            size_t length = 0;
+        };
+
+        inline char* writeDigits(char* out, unsigned value, int digits) {
+            for (int i = digits - 1; i >= 0; --i) {
+                out[i] = static_cast<char>('0' + value % 10);
+                value /= 10;
+            }
+            return out + digits;
+        }
+
+        // Format "YYYY-MM-DD HH:MM:SS" (or with 'T') for `second`
+        size_t formatSecond(long long second, Format format, char* out) {
+            std::time_t time = static_cast<std::time_t>(second);
+            std::tm tm{};
+#if defined(_WIN32)
+            if (format == Format::Local) localtime_s(&tm, &time); else gmtime_s(&tm, &time);
+#else
+            if (format == Format::Local) localtime_r(&time, &tm); else gmtime_r(&time, &tm);
+#endif
+            char* p = out;
+            p = writeDigits(p, static_cast<unsigned>(tm.tm_year + 1900), 4);
+            *p++ = '-';
+            p = writeDigits(p, static_cast<unsigned>(tm.tm_mon + 1), 2);
+            *p++ = '-';
+            p = writeDigits(p, static_cast<unsigned>(tm.tm_mday), 2);
+            *p++ = format == Format::Local ? ' ' : 'T';
+            p = writeDigits(p, static_cast<unsigned>(tm.tm_hour), 2);
+            *p++ = ':';
+            p = writeDigits(p, static_cast<unsigned>(tm.tm_min), 2);
+            *p++ = ':';
+            p = writeDigits(p, static_cast<unsigned>(tm.tm_sec), 2);
+            return static_cast<size_t>(p - out);
+        }
+    }
+
+    size_t formatTime(std::chrono::system_clock::time_point time, char* buffer, size_t size,
+                      Format format, int fractionalDigits) {
+        fractionalDigits = std::max(0, std::min(fractionalDigits, 9));
+
+        auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+        long long second = nanoseconds / 1000000000;
+        long long fraction = nanoseconds % 1000000000;
+        if (fraction < 0) {
+            // Round towards the earlier second before the epoch
+            second -= 1;
+            fraction += 1000000000;
+        }
+
+        static thread_local SecondCache caches[2];
+        SecondCache& cache = caches[format == Format::Local ? 0 : 1];
+        if (cache.second != second) {
+            cache.length = formatSecond(second, format, cache.prefix);
+            cache.second = second;
+        }
+
+        size_t length = cache.length
+            + (fractionalDigits ? 1 + static_cast<size_t>(fractionalDigits) : 0)
+            + (format == Format::Iso8601Utc ? 1 : 0);
+        if (buffer == nullptr || size <= length) return 0;
+
+        std::memcpy(buffer, cache.prefix, cache.length);
+        char* p = buffer + cache.length;
+        if (fractionalDigits) {
+            unsigned digits = static_cast<unsigned>(fraction);
+            for (int i = fractionalDigits; i < 9; ++i) digits /= 10;
+            *p++ = '.';
+            p = writeDigits(p, digits, fractionalDigits);
+        }
+        if (format == Format::Iso8601Utc) *p++ = 'Z';
+        *p = '\0';
+        return length;
+    }
+
+    size_t format(char* buffer, size_t size, Format format, int fractionalDigits) {
+        return formatTime(std::chrono::system_clock::now(), buffer, size, format, fractionalDigits);
+    }
 }
 
 // MARK: - Global utility functions
@@ -303,12 +2181,9 @@ void printSystemInfo() {
 }
 
 std::string getCurrentTimestamp() {
-    auto now = std::chrono::system_clock::now();
-    auto time_t = std::chrono::system_clock::to_time_t(now);
-    
-    std::ostringstream oss;
-    oss << std::put_time(std::localtime(&time_t), "%Y-%m-%d %H:%M:%S");
-    return oss.str();
+    char buffer[Timestamp::kMaxLength];
+    size_t length = Timestamp::format(buffer, sizeof(buffer));
+    return std::string(buffer, length);
 }
 
 void performBenchmark() {
@@ -325,6 +2200,6 @@ void performBenchmark() {
     
     timer.stop();
     
-    std::cout << "C++: Benchmark completed. Sum = " << sum << std::endl;
+    std::cout << "C++: Benchmark completed. Sum = " << shortest(sum) << std::endl;
     timer.printElapsed();
 }
\ No newline at end of file
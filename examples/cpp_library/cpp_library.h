@@ -8,6 +8,8 @@
 #include <memory>
 #include <iostream>
 #include <chrono>
+#include <cstdint>
+#include <functional>
 
 // MARK: - Math utilities
 
@@ -19,6 +21,38 @@ namespace MathUtils {
     bool isPrime(int n);
 }
 
+// MARK: - Number formatting
+
+// Locale-independent number formatting and parsing into fixed buffers, built
+// on std::to_chars/std::from_chars. Doubles are written in their shortest
+// form that parses back to the same value.
+namespace NumberFormat {
+    // Longest shortest-round-trip double ("-2.2250738585072014e-308"), plus NUL
+    constexpr size_t kMaxDoubleLength = 32;
+
+    // Each returns the length written, excluding the NUL terminator, or 0 if
+    // `size` is too small.
+    size_t formatDouble(double value, char* buffer, size_t size);
+    size_t formatFixed(double value, int precision, char* buffer, size_t size);
+    size_t formatInteger(long long value, char* buffer, size_t size);
+
+    // Parse a double at the start of `text`. Returns the characters consumed,
+    // or 0 if there is no number.
+    size_t parseDouble(const char* text, size_t length, double* value);
+
+    // Write `count` values separated by `separator`. Returns the length
+    // written, or 0 if `size` is too small.
+    size_t formatDoubles(const double* values, size_t count, char separator, char* buffer, size_t size);
+    // Parse up to `maxCount` values separated by whitespace or commas.
+    // Returns the number of values parsed.
+    size_t parseDoubles(const char* text, size_t length, double* values, size_t maxCount);
+
+    // Stream a double through formatDouble: `os << NumberFormat::shortest(x)`
+    struct Shortest { double value; };
+    inline Shortest shortest(double value) { return Shortest{value}; }
+    std::ostream& operator<<(std::ostream& os, Shortest number);
+}
+
 // MARK: - Vector operations
 
 class Vector3D {
@@ -51,6 +85,132 @@ public:
     // Utility
     void print() const;
     std::string toString() const;
+    // Write "(x, y, z)" into `buffer`, see NumberFormat
+    size_t toChars(char* buffer, size_t size) const;
+    static constexpr size_t kMaxStringLength = 3 * NumberFormat::kMaxDoubleLength + 8;
+    // Write `count` vectors as "x y z" lines into `buffer`
+    static size_t formatArray(const Vector3D* vectors, size_t count, char* buffer, size_t size);
+};
+
+// MARK: - Vector3 template
+
+// Component storage of Vector3<T>: three packed values by default
+template <typename T>
+struct Vector3Storage {
+    T x, y, z;
+};
+
+// float vectors are padded to 16 bytes with a zero fourth lane, so each one
+// is a single aligned SSE/NEON load and arrays of them vectorize cleanly
+template <>
+struct alignas(16) Vector3Storage<float> {
+    float x, y, z, w = 0.0f;
+};
+
+template <typename T>
+class Vector3 : public Vector3Storage<T> {
+public:
+    Vector3() : Vector3Storage<T>{0, 0, 0} {}
+    Vector3(T x, T y, T z) : Vector3Storage<T>{x, y, z} {}
+
+    T getX() const { return this->x; }
+    T getY() const { return this->y; }
+    T getZ() const { return this->z; }
+
+    Vector3 add(const Vector3& other) const;
+    Vector3 subtract(const Vector3& other) const;
+    Vector3 multiply(T scalar) const;
+    T dot(const Vector3& other) const;
+    Vector3 cross(const Vector3& other) const;
+    T magnitude() const;
+    Vector3 normalize() const;
+};
+
+// Instantiated in cpp_library.cpp; the typedefs name them for Swift
+extern template class Vector3<float>;
+extern template class Vector3<double>;
+using Vector3f = Vector3<float>;
+using Vector3d = Vector3<double>;
+
+static_assert(sizeof(Vector3f) == 16 && alignof(Vector3f) == 16, "Vector3f must fill one 16-byte register");
+static_assert(sizeof(Vector3d) == 3 * sizeof(double), "Vector3d must stay packed like Vector3D");
+
+// Conversions between precisions over whole arrays
+namespace Vector3Convert {
+    void toFloat(const Vector3d* in, Vector3f* out, size_t count);
+    void toDouble(const Vector3f* in, Vector3d* out, size_t count);
+    // Interleaved xyz doubles, as used by the Matrix4x4 AoS kernels
+    void toFloat(const double* xyz, Vector3f* out, size_t count);
+    void toDouble(const Vector3f* in, double* xyz, size_t count);
+}
+
+// MARK: - Matrix and quaternion transforms
+
+class Matrix4x4;
+
+// Unit quaternions for rotations, (w, x, y, z) with w the scalar part
+class Quaternion {
+private:
+    double w_, x_, y_, z_;
+
+public:
+    Quaternion();  // Identity
+    Quaternion(double w, double x, double y, double z);
+    static Quaternion fromAxisAngle(const Vector3D& axis, double radians);
+
+    double getW() const { return w_; }
+    double getX() const { return x_; }
+    double getY() const { return y_; }
+    double getZ() const { return z_; }
+
+    Quaternion multiply(const Quaternion& other) const;
+    Quaternion conjugate() const;
+    Quaternion normalize() const;
+    Vector3D rotate(const Vector3D& v) const;
+    Matrix4x4 toMatrix() const;
+
+    // Batch rotations, see Matrix4x4
+    void rotateAoS(const double* in, double* out, size_t count) const;
+    void rotateSoA(const double* inX, const double* inY, const double* inZ,
+                   double* outX, double* outY, double* outZ, size_t count) const;
+    void rotateNormalizeAoS(const double* in, double* out, size_t count) const;
+    void rotateNormalizeSoA(const double* inX, const double* inY, const double* inZ,
+                            double* outX, double* outY, double* outZ, size_t count) const;
+};
+
+// Row-major affine transform. Batch kernels use the upper 3x4 part, so the
+// last row is taken to be (0, 0, 0, 1).
+class Matrix4x4 {
+private:
+    double m_[16];
+
+public:
+    Matrix4x4();  // Identity
+    explicit Matrix4x4(const double* rowMajor);
+    static Matrix4x4 translation(double x, double y, double z);
+    static Matrix4x4 scale(double x, double y, double z);
+    static Matrix4x4 rotation(const Quaternion& q);
+
+    double get(int row, int column) const { return m_[row * 4 + column]; }
+    void set(int row, int column, double value) { m_[row * 4 + column] = value; }
+
+    Matrix4x4 multiply(const Matrix4x4& other) const;
+    Vector3D transformPoint(const Vector3D& p) const;
+    Vector3D transformDirection(const Vector3D& d) const;
+
+    // Batch kernels over `count` vectors, either interleaved xyz (AoS, 3 *
+    // count doubles) or in separate x, y and z arrays (SoA). Points get the
+    // translation, directions don't. The Normalize variants normalize the
+    // transformed directions in the same pass. `out` may be `in`.
+    void transformPointsAoS(const double* in, double* out, size_t count) const;
+    void transformPointsSoA(const double* inX, const double* inY, const double* inZ,
+                            double* outX, double* outY, double* outZ, size_t count) const;
+    void transformDirectionsAoS(const double* in, double* out, size_t count) const;
+    void transformDirectionsSoA(const double* inX, const double* inY, const double* inZ,
+                                double* outX, double* outY, double* outZ, size_t count) const;
+    void transformNormalizeAoS(const double* in, double* out, size_t count) const;
+    void transformNormalizeSoA(const double* inX, const double* inY, const double* inZ,
+                               double* outX, double* outY, double* outZ, size_t count) const;
 };
 
 // MARK: - String utilities
@@ -64,12 +224,190 @@ namespace StringUtils {
     std::string simpleJoin(const std::string& str1, const std::string& str2, const std::string& separator);
 }
 
+// MARK: - Distinct counting
+
+// HyperLogLog sketch of the number of distinct doubles, with Ertl's improved
+// estimator (no empirical bias tables). 2^precision one-byte registers give
+// a standard error of about 1.04 / sqrt(2^precision): the default 13 uses
+// 8 KB for ~1.1%. +0.0 and -0.0 count as one value, as do all NaNs.
+class HyperLogLog {
+private:
+    std::vector<uint8_t> registers_;
+    int precision_ = 0;
+
+public:
+    static constexpr int kDefaultPrecision = 13;
+    static constexpr int kMinPrecision = 4;
+    static constexpr int kMaxPrecision = 18;
+
+    HyperLogLog() = default;  // Empty: isEnabled() is false
+    explicit HyperLogLog(int precision);
+
+    bool isEnabled() const { return precision_ != 0; }
+    int getPrecision() const { return precision_; }
+
+    void add(double value);
+    void addMultiple(const double* values, size_t count);
+    void clear();
+    double estimate() const;
+
+    // Combine with a sketch of the same precision, as if it had seen the
+    // values of both. Returns false if the precisions differ.
+    bool merge(const HyperLogLog& other);
+
+    // "HLL1", the precision, then the registers
+    size_t serializedSize() const;
+    size_t serialize(uint8_t* buffer, size_t size) const;
+    static bool deserialize(const uint8_t* buffer, size_t size, HyperLogLog* sketch);
+};
+
+// MARK: - Block summaries
+
+// Count, sum, extremes and spread of a run of values, mergeable so that
+// summaries of blocks answer reductions over any run of whole blocks
+struct DataSummary {
+    size_t count = 0;
+    double sum = 0.0;
+    double min = 0.0;
+    double max = 0.0;
+    double m2 = 0.0;  // Sum of squared deviations from the mean
+
+    static DataSummary of(const double* values, size_t count);
+    // Combine with the summary of other values (Chan et al.)
+    void merge(const DataSummary& other);
+};
+
+// MARK: - Compressed series
+
+// Append-only doubles compressed as in Gorilla (Pelkonen et al., VLDB 2015):
+// each value is XORed with the previous one and only the bits that differ
+// are stored, so a slowly changing series takes from one bit to a few bytes
+// per value. Values are sealed into independently decodable blocks of
+// kBlockSize with a summary that answers whole-block reductions without
+// decoding; the last, partial block is kept uncompressed.
+class CompressedSeries {
+public:
+    static constexpr size_t kBlockSize = 1024;
+
+    void add(double value);
+    void addMultiple(const double* values, size_t count);
+    void clear();
+
+    size_t size() const { return blocks_.size() * kBlockSize + tail_.size(); }
+    // Heap memory held for the values, summaries included
+    size_t getMemoryBytes() const;
+    // Value at `index`, decoding its block up to it; 0 past the end
+    double at(size_t index) const;
+    // Summary of the values at indices [begin, end), decoding at most the
+    // two partial blocks at its ends
+    DataSummary summarize(size_t begin, size_t end) const;
+    // Call `visit` with consecutive runs of the values at [begin, end), each
+    // within one block, decoded into a buffer valid for the call only
+    void forEachBlock(size_t begin, size_t end, const std::function<void(const double*, size_t)>& visit) const;
+
+private:
+    struct Block {
+        std::vector<uint64_t> words;  // Bit stream, most significant bit first
+        DataSummary summary;
+    };
+    std::vector<Block> blocks_;
+    std::vector<double> tail_;
+
+    void seal();
+    // Decode the first `count` values of block `block`
+    void decode(size_t block, size_t count, double* values) const;
+};
+
+// MARK: - Columnar snapshots
+
+// Read-only view of a DataProcessor snapshot file: a 64-byte header, the
+// values as one array of doubles split into blocks, then a footer with the
+// DataSummary and CRC-32 of every block. Files are memory-mapped on POSIX
+// systems and read whole elsewhere, so opening one only reads its header
+// and footer; whole-block reductions never touch the values.
+class ColumnarSnapshot {
+public:
+    // Values per block in the files written by DataProcessor::save
+    static constexpr size_t kBlockSize = 16384;
+
+    ColumnarSnapshot() = default;
+    ~ColumnarSnapshot();
+    ColumnarSnapshot(const ColumnarSnapshot&) = delete;
+    ColumnarSnapshot& operator=(const ColumnarSnapshot&) = delete;
+
+    // Open `path`, checking its header and the footer checksum. Returns
+    // false, leaving the snapshot closed, if it is not a valid snapshot.
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const { return values_ != nullptr; }
+    bool isMapped() const { return mapping_ != nullptr; }
+
+    size_t size() const { return count_; }
+    const double* values() const { return values_; }
+    size_t getBlockSize() const { return blockSize_; }
+    size_t getBlockCount() const { return blocks_.size(); }
+    const DataSummary& getBlockSummary(size_t block) const { return blocks_[block]; }
+    // Summary of the values at [begin, end), reading only the partial
+    // blocks at its ends
+    DataSummary summarize(size_t begin, size_t end) const;
+    // Check the CRC-32 of every block, reading all the values
+    bool verify() const;
+
+    // Write `count` values, produced in order by `forEachRun` calling its
+    // argument with runs of them, atomically replacing `path`
+    static bool write(const std::string& path, size_t count,
+                      const std::function<void(const std::function<void(const double*, size_t)>&)>& forEachRun);
+
+private:
+    void* mapping_ = nullptr;
+    size_t mappingSize_ = 0;
+    std::vector<double> buffer_;  // The values when not mapped
+    const double* values_ = nullptr;
+    size_t count_ = 0;
+    size_t blockSize_ = 0;
+    std::vector<DataSummary> blocks_;
+    std::vector<uint32_t> checksums_;
+};
+
 // MARK: - Data processor
 
+class DataPipeline;
+
 class DataProcessor {
 private:
     std::vector<double> data_;
     std::string name_;
+
+    // Range index, built on the first range query and extended to the data
+    // appended since on the next one. Prefix sums carry their compensation
+    // terms. minTable_[0] / maxTable_[0] hold the extremes of each complete
+    // block of kRangeIndexBlock values, and minTable_[k][i] / maxTable_[k][i]
+    // those of blocks [i, i + 2^k), so the tables take O(n / block * log n).
+    static constexpr size_t kRangeIndexBlock = 256;
+    mutable size_t indexedCount_ = 0;
+    mutable std::vector<double> prefixSums_;
+    mutable std::vector<double> prefixCompensations_;
+    mutable std::vector<std::vector<double>> minTable_;
+    mutable std::vector<std::vector<double>> maxTable_;
+    void updateRangeIndex() const;
+
+    // Distinct-count sketch, updated by addData/addMultipleData once enabled
+    HyperLogLog distinct_;
+
+    // With compressed storage the values live in compressedData_ instead of
+    // data_, and range queries use its block summaries instead of the index
+    bool compressed_ = false;
+    CompressedSeries compressedData_;
+    // After load, the values are the snapshot's until the first change
+    // copies them into data_; its footer answers the reductions meanwhile
+    std::shared_ptr<const ColumnarSnapshot> snapshot_;
+    void detachSnapshot();
+    void resetRangeIndex();
+
+    // Call `visit` with runs of the values at [begin, end) from any storage
+    void forEachBlock(size_t begin, size_t end, const std::function<void(const double*, size_t)>& visit) const;
+    // Summary from the compressed or snapshot block summaries; false for data_
+    bool summarizeBlocks(size_t begin, size_t end, DataSummary* summary) const;
     
 public:
     DataProcessor(const std::string& name);
@@ -87,8 +425,125 @@ public:
     
     double getDataAtIndex(size_t index) const;
     void printStatistics() const;
+
+    // Count the values into `bins` equal-width bins over [lo, hi], writing
+    // `bins` counts into `counts`. Like numpy.histogram, every bin is
+    // half-open except the last, which includes `hi`; values outside the
+    // range and NaNs are not counted. Returns false for an invalid range.
+    bool histogram(size_t bins, double lo, double hi, size_t* counts) const;
+    // Same with the `edgeCount` finite, ascending bin edges of
+    // `edgeCount - 1` bins
+    bool histogram(const double* edges, size_t edgeCount, size_t* counts) const;
+
+    // Statistics over the values at indices [begin, end), 0 for an empty
+    // range. Sums are O(1) from the range index, and min/max O(1) plus a
+    // scan of the partial blocks at both ends, at the cost of one pass over
+    // new data after appends. Not thread-safe.
+    double getRangeSum(size_t begin, size_t end) const;
+    double getRangeAverage(size_t begin, size_t end) const;
+    double getRangeMin(size_t begin, size_t end) const;
+    double getRangeMax(size_t begin, size_t end) const;
+
+    // Approximate number of distinct values, see HyperLogLog. Enabling it
+    // adds the current data to the sketch; clearData empties it.
+    void enableDistinctCount(int precision = HyperLogLog::kDefaultPrecision);
+    bool isDistinctCountEnabled() const { return distinct_.isEnabled(); }
+    double getDistinctCountEstimate() const { return distinct_.estimate(); }
+    // Fold in the distinct values of `other`, whose sketch must use the same precision
+    bool mergeDistinctCount(const DataProcessor& other) { return distinct_.merge(other.distinct_); }
+    const HyperLogLog& getDistinctCountSketch() const { return distinct_; }
+
+    // Move the values into a CompressedSeries and keep them there, at the
+    // cost of decoding for getDataAtIndex, histograms and partial ranges.
+    // getSum/getMin/getMax/getStandardDeviation read the block summaries,
+    // as do range queries, which then only decode the blocks at their ends.
+    void enableCompressedStorage();
+    bool isCompressedStorageEnabled() const { return compressed_; }
+    // Heap memory held for the values, excluding the range index and sketch
+    size_t getStorageBytes() const;
+
+    // Snapshot the values into a ColumnarSnapshot file at `path`
+    bool save(const std::string& path) const;
+    // Lazy filter/map pipeline over the current values, see DataPipeline
+    DataPipeline pipeline() const;
+
+    // Replace the values and storage mode with the snapshot at `path`,
+    // mapped rather than copied, checking every block's CRC-32 unless
+    // `verifyChecksums` is false. Without checking, loading only reads the
+    // header and footer. Returns false, changing nothing, on invalid files.
+    bool load(const std::string& path, bool verifyChecksums = true);
     
     const std::string& getName() const { return name_; }
+
+    friend class DataPipeline;
+};
+
+// MARK: - Data pipelines
+
+enum class PipelineFilter {
+    Greater,       // x > operand
+    GreaterEqual,  // x >= operand
+    Less,          // x < operand
+    LessEqual,     // x <= operand
+    Equal,         // x == operand
+    NotEqual,      // x != operand
+    Finite         // Neither infinite nor NaN
+};
+
+enum class PipelineMap {
+    Add,       // x + operand
+    Multiply,  // x * operand
+    Min,       // min(x, operand)
+    Max,       // max(x, operand)
+    Abs,
+    Negate,
+    Square,
+    Sqrt,
+    Log,
+    Exp
+};
+
+// Lazy filters and maps over the values of a DataProcessor, run by a
+// terminal operation in one fused pass: each chunk of kChunkSize values is
+// copied once into a buffer, every step runs over the whole chunk in a
+// branch-free loop, and filters only clear lanes of a mask. For instance the
+// statistics of log(x) for x > t, without copying the data:
+//     processor.pipeline().filter(PipelineFilter::Greater, t).map(PipelineMap::Log).stats()
+// A pipeline references its processor, which must outlive it and not change
+// while a terminal operation runs.
+class DataPipeline {
+public:
+    static constexpr size_t kChunkSize = 1024;
+
+    explicit DataPipeline(const DataProcessor& source) : source_(&source) {}
+
+    DataPipeline filter(PipelineFilter filter, double operand = 0.0) const;
+    DataPipeline map(PipelineMap map, double operand = 0.0) const;
+
+    // Summary of the values passing every filter
+    DataSummary stats() const;
+    // As DataProcessor::histogram, over the values passing every filter
+    bool histogram(size_t bins, double lo, double hi, size_t* counts) const;
+    // The value of rank floor(q * (count - 1)) among the passing values,
+    // NaNs excluded; 0 if there are none or q is outside [0, 1]. Found by
+    // radix selection on 16 bits a pass, without sorting or copying them.
+    double quantile(double q) const;
+
+private:
+    struct Step {
+        bool isFilter;
+        PipelineFilter filter;
+        PipelineMap map;
+        double operand;
+    };
+    const DataProcessor* source_;
+    std::vector<Step> steps_;
+
+    // Run the steps over the values at [begin, end), passing each chunk of
+    // kChunkSize values, its mask (all ones for values passing every filter,
+    // 0 for the others and for the lanes past the `n` values read) and `n`
+    // to `consume`
+    void run(size_t begin, size_t end, const std::function<void(double*, const uint64_t*, size_t)>& consume) const;
 };
 
 // MARK: - Timer class
@@ -112,6 +567,28 @@ public:
     void printElapsed() const;
 };
 
+// MARK: - Timestamp formatting
+
+// Allocation-free, thread-safe timestamps for logging. Each thread caches the
+// formatted date and time of the current second, so only the sub-second
+// digits are formatted on most calls.
+namespace Timestamp {
+    enum class Format {
+        Local,       // 2024-01-31 13:45:10[.123] in the local time zone
+        Iso8601Utc   // 2024-01-31T12:45:10[.123]Z
+    };
+
+    // Large enough for every format with 9 fractional digits and the terminator
+    constexpr size_t kMaxLength = 32;
+
+    // Write the current time into `buffer` with `fractionalDigits` (0-9)
+    // sub-second digits. Returns the length written, excluding the NUL
+    // terminator, or 0 if `size` is too small.
+    size_t format(char* buffer, size_t size, Format format = Format::Local, int fractionalDigits = 0);
+    size_t formatTime(std::chrono::system_clock::time_point time, char* buffer, size_t size,
+                      Format format = Format::Local, int fractionalDigits = 0);
+}
+
 // MARK: - Global utility functions
 
 void initializeCppLibrary();
@@ -0,0 +1,53 @@
+// main.swift
+// Measures calls into SwiftLibrary from a client module.
+//
+// Without cross-module optimization the calls below stay opaque calls into
+// SwiftLibrary. Compare:
+//   scons swiftflags=-O
+//   scons swiftflags=-O swift_cmo=full
+
+import Dispatch
+import SwiftLibrary
+
+let iterations = 10_000_000
+
+func measure(_ name: String, _ body: () -> Double) {
+    let start = DispatchTime.now().uptimeNanoseconds
+    let checksum = body()
+    let elapsed = DispatchTime.now().uptimeNanoseconds - start
+    let perCall = Double(elapsed) / Double(iterations)
+    print("\(name): \(perCall) ns/call (checksum: \(checksum))")
+}
+
+print("=== SwiftLibrary client benchmark ===")
+
+measure("Point.distance") {
+    let origin = Point(x: 0.0, y: 0.0)
+    var sum = 0.0
+    for i in 0..<iterations {
+        let p = Point(x: Double(i & 1023), y: 4.0)
+        sum += p.distance(to: origin)
+    }
+    return sum
+}
+
+measure("CalculatorStruct.addOnly") {
+    let calculator = CalculatorStruct()
+    var sum = 0.0
+    for i in 0..<iterations {
+        sum = calculator.addOnly(sum, Double(i & 7))
+    }
+    return sum
+}
+
+measure("CalculatorStruct.add") {
+    var calculator = CalculatorStruct()
+    var sum = 0.0
+    for i in 0..<iterations {
+        sum = calculator.add(sum, 1.0)
+        if i & 1023 == 0 {
+            calculator.clearHistory()
+        }
+    }
+    return sum
+}
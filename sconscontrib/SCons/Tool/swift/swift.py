@@ -35,11 +35,17 @@ selection method.
 #
 
 import os
+import re
 import SCons.Action
 import SCons.Builder
 import SCons.Defaults
+import SCons.Errors
+import SCons.Node.FS
+import SCons.Scanner
+import SCons.Subst
 import SCons.Tool
 import SCons.Util
+import SCons.Warnings
 
 # Swift source file suffixes
 SwiftSuffixes = [".swift"]
@@ -47,6 +53,63 @@ SwiftSuffixes = [".swift"]
 # Swift compiler to use
 compilers = ["swiftc"]
 
+# Outputs whose optimization records (path of the .opt.yaml files) are
+# aggregated by SwiftOptimizationReport, filled by the emitters
+_swift_opt_records = []
+
+# Programs and libraries broken down by SwiftSizeReport, filled by the emitters
+_swift_size_artifacts = []
+
+# Matches `import Foo`, `@testable import Foo` and `import struct Foo.Bar`
+_swift_import_re = re.compile(
+    r"^[ \t]*(?:@\w+(?:\([^)]*\))?\s+)*import\s+"
+    r"(?:(?:typealias|struct|class|enum|protocol|let|var|func)\s+)?(\w+)",
+    re.M,
+)
+
+
+# Imports of each source, keyed by its source node and content signature,
+# so the variant dir copies of a source are parsed once
+_swift_import_cache = {}
+
+def _swift_imports(node):
+    """Return the modules imported by a Swift source, in order"""
+    src = node.srcnode()
+    key = (src, src.get_csig())
+    modules = _swift_import_cache.get(key)
+    if modules is None:
+        modules = []
+        for name in _swift_import_re.findall(src.get_text_contents()):
+            if name not in modules:
+                modules.append(name)
+        _swift_import_cache[key] = modules
+    return modules
+
+def _swift_scan(node, env, path):
+    """Find the .swiftmodule files of modules imported by a Swift source.
+
+    Only modules found in SWIFTPATH are returned, so the dependency on
+    modules built by this tree orders checks and builds correctly, while
+    SDK and C++ modules are left to the compiler.
+    """
+    modules = _swift_imports(node)
+
+    suffix = env.subst("$SWIFTMODULESUFFIX")
+    deps = []
+    for name in modules:
+        module = SCons.Node.FS.find_file(name + suffix, path)
+        if module:
+            deps.append(module)
+    return deps
+
+
+SwiftScanner = SCons.Scanner.ScannerBase(
+    _swift_scan,
+    name="SwiftScanner",
+    skeys=SwiftSuffixes,
+    path_function=SCons.Scanner.FindPathDirs("SWIFTPATH"),
+)
+
 def _swift_cxx_header_emitter(target, source, env):
     # Swift generates additional files alongside object files
     base = SCons.Util.splitext(str(target[0]))[0]
@@ -61,8 +124,54 @@ def _swift_cxx_header_emitter(target, source, env):
             env["_SWIFT_CXX_HEADER_NAME"] = cxx_header
             target.append(cxx_header)
 
+            expose = env.get("SWIFT_CXX_EXPOSE_DECLS")
+            if expose and expose not in ("all-public", "has-expose-attr"):
+                raise SCons.Errors.UserError(
+                    "SWIFT_CXX_EXPOSE_DECLS must be 'all-public' or "
+                    "'has-expose-attr', not %r" % expose
+                )
+
+            if env.get("SWIFT_CXX_HEADER_REPORT"):
+                report = env.SwiftCxxHeaderReport(
+                    cxx_header.name + env.subst("$SWIFTCXXHEADERREPORTSUFFIX"),
+                    cxx_header,
+                )
+                env.Alias("swift-cxx-header-report", report)
+
     return target, source
 
+def _swift_cxx_header_report(target, source, env):
+    """Write the size, exposed declarations and parse time of a generated header"""
+    import subprocess
+    import time
+
+    header = source[0].get_abspath()
+    with open(header) as f:
+        text = f.read()
+
+    environ = {k: str(v) for k, v in env["ENV"].items()}
+    runs = max(1, int(env.get("SWIFTCXXHEADERREPORTRUNS", 1)))
+    parse_times = []
+    for _ in range(runs):
+        start = time.perf_counter()
+        for cmd in env.subst_list("$SWIFTCXXHEADERPARSECOM", SCons.Subst.SUBST_CMD, target, source):
+            result = subprocess.run(
+                [str(arg) for arg in cmd], env=environ, capture_output=True, text=True
+            )
+            if result.returncode != 0:
+                print(result.stderr, end="")
+                return result.returncode
+        parse_times.append(time.perf_counter() - start)
+
+    with open(target[0].get_abspath(), "w") as f:
+        f.write("header: %s\n" % source[0])
+        f.write("expose: %s\n" % (env.get("SWIFT_CXX_EXPOSE_DECLS") or "default"))
+        f.write("size: %d bytes\n" % len(text.encode()))
+        f.write("lines: %d\n" % text.count("\n"))
+        f.write("exposed declarations: %d\n" % text.count("SWIFT_SYMBOL("))
+        f.write("parse time: %.1f ms (best of %d)\n" % (min(parse_times) * 1000, runs))
+    return 0
+
 def _swift_emitter(target, source, env):
     """Add swiftmodule, swiftdoc, and swiftsourceinfo files to targets when building object files"""
     # Swift generates additional files alongside object files
@@ -77,7 +186,187 @@ def _swift_emitter(target, source, env):
 
     return target, source
 
+def _swift_check_emitter(target, source, env):
+    """Register a typecheck of the sources under the swift-check alias"""
+    if env.get("SWIFT_TYPECHECK_ONLY"):
+        base = SCons.Util.splitext(str(target[0]))[0]
+        check = env.SwiftCheck(
+            base + env.subst("$SWIFTCHECKSUFFIX"),
+            source,
+            _SWIFTCHECKBUILDERFLAGS=env.get("_SWIFTCHECKBUILDERFLAGS"),
+        )
+        env.Alias("swift-check", check)
+
+    return target, source
+
+def _swift_typecheck_report_emitter(target, source, env):
+    """Add the type-check hotspot report when timing thresholds are set"""
+    # Function bodies are only checked by SwiftCheck in typecheck-only mode
+    check_suffix = env.subst("$SWIFTCHECKSUFFIX")
+    if env.get("SWIFT_TYPECHECK_ONLY") and not str(target[0]).endswith(check_suffix):
+        return target, source
+
+    if _swift_reports_typecheck_timing(env):
+        base = SCons.Util.splitext(str(target[0]))[0]
+        report = env.File(base + env.subst("$SWIFTTYPECHECKREPORTSUFFIX"))
+        target.append(report)
+
+    return target, source
+
+def _swift_headermap_emitter(target, source, env):
+    """Generate a Clang header map for the target when SWIFT_CLANG_HEADERMAP is set"""
+    if env.get("SWIFT_CLANG_HEADERMAP"):
+        headermap = env.SwiftHeaderMap(
+            str(target[0]) + env.subst("$SWIFTHEADERMAPSUFFIX"), []
+        )
+        env["_SWIFT_CLANG_HEADERMAP"] = headermap[0]
+        env.Depends(target, headermap)
+
+    return target, source
+
+def _swift_prebuilt_modules_emitter(target, source, env):
+    """Make Swift targets depend on the prebuilt module cache they use"""
+    manifest = env.get("_SWIFT_PREBUILT_MODULES")
+    if manifest:
+        env.Depends(target, manifest)
+
+    return target, source
+
+def _swift_split_debug_emitter(target, source, env):
+    """Add the stripped artifact and its separate debug info as targets"""
+    if not env.get("SWIFT_SPLIT_DEBUG_INFO") or env.get("SWIFT_TYPECHECK_ONLY"):
+        return target, source
+
+    artifact = target[0]
+    stripped = env.File(
+        os.path.join(env.subst("$SWIFT_STRIPPED_DIR"), artifact.name),
+        artifact.dir,
+    )
+    # Next to the stripped artifact, where gdb and lldb look up its debuglink
+    debug = env.File(artifact.name + env.subst("$SWIFTDEBUGSUFFIX"), stripped.dir)
+    env.Alias("swift-stripped", env._SwiftSplitDebug([stripped, debug], artifact))
+
+    return target, source
+
+_SWIFT_OPTIMIZE_FLAGS = ("-O", "-Osize", "-Ounchecked")
+
+def _swift_cmo_emitter(target, source, env):
+    """Check that cross-module optimization can serialize SIL into the module"""
+    cmo = env.get("SWIFT_CROSS_MODULE_OPTIMIZATION")
+    if not cmo or env.get("SWIFT_TYPECHECK_ONLY"):
+        return target, source
+    if cmo not in ("full", "default"):
+        raise SCons.Errors.UserError(
+            "SWIFT_CROSS_MODULE_OPTIMIZATION must be 'full' or 'default', not %r" % cmo
+        )
+
+    flags = _swift_optimization_flags(env)
+    if not any(f in _SWIFT_OPTIMIZE_FLAGS for f in flags):
+        SCons.Warnings.warn(
+            SCons.Warnings.WarningOnByDefault,
+            "%s: cross-module optimization has no effect without -O" % target[0],
+        )
+    if "-enable-library-evolution" in flags:
+        SCons.Warnings.warn(
+            SCons.Warnings.WarningOnByDefault,
+            "%s: cross-module optimization is disabled by -enable-library-evolution"
+            % target[0],
+        )
+
+    return target, source
+
+def _swift_optimization_flags(env):
+    return env.subst("$SWIFTFLAGS $SWIFTMODULEFLAGS $SWIFTLIBFLAGS").split()
+
+def _swift_is_whole_module(flags):
+    return "-wmo" in flags or "-whole-module-optimization" in flags
+
+def _swift_wmo_flags(env):
+    """-wmo unless already in the flags, as CMO only runs in whole-module mode.
+
+    -num-threads keeps one object per source, which the module builders
+    declare as their targets.
+    """
+    if _swift_is_whole_module(_swift_optimization_flags(env)):
+        return []
+    return ["-wmo", "-num-threads", str(env.get("SWIFT_WMO_THREADS") or 1)]
+
+def _swift_cmo_flags(target, source, env, for_signature):
+    cmo = env.get("SWIFT_CROSS_MODULE_OPTIMIZATION")
+    if env.get("SWIFT_TYPECHECK_ONLY"):
+        return []
+    if cmo == "full":
+        return _swift_wmo_flags(env) + ["-cross-module-optimization"]
+    if cmo == "default":
+        return _swift_wmo_flags(env) + ["-Xfrontend", "-enable-default-cmo"]
+    return []
+
+def _swift_opt_record_outputs(target, source, env):
+    """The optimization records of a Swift program or library: one next to the
+    output for a single frontend job, otherwise one per source"""
+    flags = env.subst("$SWIFTFLAGS $_SWIFTCHECKBUILDERFLAGS").split()
+    whole_module = _swift_is_whole_module(flags) or (
+        env.get("_SWIFT_OPT_RECORD_CMO") and env.get("SWIFT_CROSS_MODULE_OPTIMIZATION")
+    )
+    if len(source) == 1 or whole_module:
+        return [env.File(str(target[0]) + ".opt.yaml")]
+    return [
+        env.File(
+            "%s.%s.opt.yaml" % (target[0], os.path.basename(SCons.Util.splitext(str(s))[0]))
+        )
+        for s in source
+    ]
+
+def _swift_opt_record_emitter(target, source, env):
+    """Register the optimization records of a Swift program or library, with
+    the output file map naming them when there is one per source"""
+    if env.get("SWIFT_OPTIMIZATION_RECORD") and not env.get("SWIFT_TYPECHECK_ONLY"):
+        records = _swift_opt_record_outputs(target, source, env)
+        if len(records) > 1:
+            import json
+
+            # Keyed by both the path on the command line and the absolute one,
+            # as drivers differ in which they look up
+            outputs = {}
+            for s, r in zip(source, records):
+                for key in (str(s), s.get_abspath()):
+                    outputs[key] = {"yaml-opt-record": r.get_abspath()}
+            output_file_map = env._SwiftOutputFileMap(
+                str(target[0]) + "$SWIFTOUTPUTFILEMAPSUFFIX",
+                env.Value(json.dumps(outputs, indent=1, sort_keys=True)),
+            )
+            env.Depends(target, output_file_map)
+        env.SideEffect(records, target)
+        _swift_opt_records.append((target[0], records))
+
+    return target, source
+
+def _swift_module_opt_record_emitter(target, source, env):
+    """Register the optimization records written for each primary file of a module"""
+    if env.get("SWIFT_OPTIMIZATION_RECORD") and not env.get("SWIFT_TYPECHECK_ONLY"):
+        records = [
+            env.File(SCons.Util.splitext(str(s))[0] + ".opt.yaml") for s in source
+        ]
+        env.SideEffect(records, target)
+        _swift_opt_records.append((target[0], records))
+
+    return target, source
+
+def _swift_cc_opt_record_emitter(target, source, env):
+    """Register the optimization records written by a C or C++ compile"""
+    if env.get("SWIFT_OPTIMIZATION_RECORD") and env.subst("$SWIFT_CC_OPTIMIZATION_RECORD_FLAGS"):
+        for t in target:
+            record = env.File(SCons.Util.splitext(str(t))[0] + ".opt.yaml")
+            env.SideEffect(record, t)
+            _swift_opt_records.append((t, [record]))
+
+    return target, source
+
 def _swift_obj_emitter(target, source, env):
+    # Nothing is compiled when only type checking
+    if env.get("SWIFT_TYPECHECK_ONLY"):
+        return target, source
+
     for s in source:
         name = SCons.Util.splitext(str(s))[0]
         f = env.File(name + ".o")
@@ -85,6 +374,1101 @@ def _swift_obj_emitter(target, source, env):
 
     return target, source
 
+def _swift_reports_typecheck_timing(env):
+    return bool(
+        env.get("SWIFT_WARN_LONG_FUNCTION_MS") or env.get("SWIFT_WARN_LONG_EXPR_MS")
+    )
+
+# Matches the diagnostics of -warn-long-function-bodies and
+# -warn-long-expression-type-checking
+_swift_long_typecheck_re = re.compile(
+    r"^(?P<location>\S.*?:\d+:\d+): warning: (?P<what>.+?) took (?P<ms>\d+)ms "
+    r"to type-check \(limit: (?P<limit>\d+)ms\)",
+    re.M,
+)
+
+
+def _swift_run_captured(com, target, source, env):
+    """Run a command line, echo its output and return (status, output)"""
+    import subprocess
+    import sys
+
+    environ = {k: str(v) for k, v in env["ENV"].items()}
+    output = []
+    for cmd in env.subst_list(com, SCons.Subst.SUBST_CMD, target, source):
+        args = [str(arg) for arg in cmd]
+        if not args:
+            continue
+        result = subprocess.run(args, env=environ, capture_output=True, text=True)
+        sys.stdout.write(result.stdout)
+        sys.stderr.write(result.stderr)
+        output.append(result.stdout)
+        output.append(result.stderr)
+        if result.returncode != 0:
+            return result.returncode, "".join(output)
+    return 0, "".join(output)
+
+
+def _swift_typecheck_timing_action(com):
+    """Wrap `com` so its type-check timing warnings are written to the report"""
+
+    def action(target, source, env):
+        import sys
+
+        status, output = _swift_run_captured(com, target, source, env)
+
+        hotspots = {}
+        for m in _swift_long_typecheck_re.finditer(output):
+            key = (m.group("location"), m.group("what"))
+            hotspots[key] = max(hotspots.get(key, 0), int(m.group("ms")))
+        ranked = sorted(hotspots.items(), key=lambda item: -item[1])
+
+        suffix = env.subst("$SWIFTTYPECHECKREPORTSUFFIX")
+        name = env.subst("$SWIFTMODULENAME") or os.path.basename(
+            SCons.Util.splitext(str(target[0]))[0]
+        )
+        for report in [t for t in target if str(t).endswith(suffix)]:
+            with open(report.get_abspath(), "w") as f:
+                f.write("# %s: %d type-check hotspot(s)\n" % (name, len(ranked)))
+                for (location, what), ms in ranked:
+                    f.write("%6dms  %s: %s\n" % (ms, location, what))
+
+        if status == 0 and ranked and env.get("SWIFT_WARN_LONG_AS_ERROR"):
+            sys.stderr.write(
+                "error: %s has %d function(s) or expression(s) over the type-check limit\n"
+                % (name, len(ranked))
+            )
+            return 1
+        return status
+
+    return action
+
+
+def _swift_worker_inputs(target, env, root):
+    """Return the files a job reads: sources, dependencies and the files of
+    the Swift search paths, such as module maps and their headers"""
+    nodes = []
+    for t in target:
+        nodes += t.sources + t.depends + (t.implicit or [])
+    paths = set()
+    for node in nodes:
+        path = node.srcnode().get_abspath()
+        if not os.path.isfile(path):
+            path = node.get_abspath()
+        paths.add(path)
+    for d in _swift_headermap_dirs(env, target[0]):
+        top = d.srcnode().get_abspath()
+        if os.path.isdir(top):
+            for name in os.listdir(top):
+                paths.add(os.path.join(top, name))
+    return sorted(
+        p for p in paths if os.path.isfile(p) and p.startswith(root + os.sep)
+    )
+
+def _swift_worker_action(com):
+    """Wrap `com` so it runs on one of SWIFT_WORKERS, or locally when none answers.
+
+    Each command line, the swiftc invocation of a whole module, is one job:
+    modules are spread over the workers, the files of a module are not.
+    Running a job locally because no worker took it is reported as a warning.
+    """
+
+    def action(target, source, env):
+        import subprocess
+        import sys
+        import zlib
+
+        from . import worker
+
+        root = env.Dir("#").get_abspath()
+        inputs = _swift_worker_inputs(target, env, root)
+        outputs = [t.get_abspath() for t in target]
+        for t in target:
+            outputs += [s.get_abspath() for s in t.side_effects]
+        workers = [str(w) for w in SCons.Util.flatten(env["SWIFT_WORKERS"])]
+        first = zlib.crc32(str(target[0]).encode()) % len(workers)
+        environ = {k: str(v) for k, v in env["ENV"].items()}
+        timeout = env.get("SWIFT_WORKER_TIMEOUT") or None
+        token = env.subst("$SWIFT_WORKER_TOKEN") or None
+
+        for cmd in env.subst_list(com, SCons.Subst.SUBST_CMD, target, source):
+            args = [str(arg) for arg in cmd]
+            if not args:
+                continue
+            errors = []
+            for i in range(len(workers)):
+                address = workers[(first + i) % len(workers)]
+                try:
+                    status, stdout, stderr = worker.run(
+                        address,
+                        args, os.getcwd(), root, inputs, outputs, environ, timeout,
+                        token,
+                    )
+                    stdout = stdout.replace(worker.ROOT, root)
+                    stderr = stderr.replace(worker.ROOT, root)
+                    break
+                except (OSError, ValueError, KeyError, TypeError) as e:
+                    # Unreachable, refused, or a malformed reply: try the next one
+                    errors.append("%s: %s" % (address, e))
+                    continue
+            else:
+                # No worker ran the job: run it here
+                SCons.Warnings.warn(
+                    SCons.Warnings.WarningOnByDefault,
+                    "%s: no Swift worker ran the job, building locally (%s)"
+                    % (target[0], "; ".join(errors)),
+                )
+                result = subprocess.run(args, env=environ, capture_output=True, text=True)
+                status, stdout, stderr = result.returncode, result.stdout, result.stderr
+            sys.stdout.write(stdout)
+            sys.stderr.write(stderr)
+            if status != 0:
+                return status
+        return 0
+
+    return action
+
+def _swift_command_action(com, comstr, env, for_signature, remote=False):
+    """Create the action running `com`, capturing diagnostics when needed.
+
+    With `remote`, frontend jobs are dispatched to SWIFT_WORKERS when set,
+    except while reporting type-check timing: the report is parsed from
+    the diagnostics of a local run, so it takes precedence.
+    """
+    if not for_signature and _swift_reports_typecheck_timing(env):
+        return SCons.Action.Action(_swift_typecheck_timing_action(com), comstr)
+    if not for_signature and remote and env.get("SWIFT_WORKERS"):
+        return SCons.Action.Action(_swift_worker_action(com), comstr)
+    return SCons.Action.Action(com, comstr)
+
+def _swift_module_generator(source, target, env, for_signature):
+    if env.get("SWIFT_TYPECHECK_ONLY"):
+        return _swift_command_action(
+            "$SWIFTMODULECHECKCOM", "$SWIFTMODULECHECKCOMSTR", env, for_signature
+        )
+    return _swift_command_action(
+        "$SWIFTMODULECOM", "$SWIFTMODULECOMSTR", env, for_signature, remote=True
+    )
+
+def _swift_lib_generator(source, target, env, for_signature):
+    return _swift_command_action("$SWIFTLIBCOM", "$SWIFTLIBCOMSTR", env, for_signature)
+
+def _swift_exe_generator(source, target, env, for_signature):
+    return _swift_command_action("$SWIFTEXECOM", "$SWIFTEXECOMSTR", env, for_signature)
+
+def _swift_emit_module_generator(source, target, env, for_signature):
+    return _swift_command_action(
+        "$SWIFTEMITMODULECOM", "$SWIFTEMITMODULECOMSTR", env, for_signature, remote=True
+    )
+
+def _swift_objects_generator(source, target, env, for_signature):
+    return _swift_command_action(
+        "$SWIFTOBJECTSCOM", "$SWIFTOBJECTSCOMSTR", env, for_signature, remote=True
+    )
+
+def _swift_check_generator(source, target, env, for_signature):
+    return [
+        _swift_command_action("$SWIFTCHECKCOM", "$SWIFTCHECKCOMSTR", env, for_signature),
+        SCons.Defaults.Touch("$TARGET"),
+    ]
+
+def _swift_headermap_dirs(env, node):
+    """Return the directories whose headers are served by the header map"""
+    dirs = []
+    for var in ("SWIFT_CLANG_HEADERMAP_PATH", "SWIFTPATH"):
+        for d in SCons.Scanner.FindPathDirs(var)(env, node.cwd):
+            if d not in dirs:
+                dirs.append(d)
+    return dirs
+
+def _swift_known_headers(env, node):
+    """Return (include name, node) for the SCons headers under the header map dirs.
+
+    Both files on disk and headers that will be generated by the build are
+    found, in search order, so the first directory wins on conflicts.
+    """
+    suffixes = env.Flatten(env.get("SWIFT_CLANG_HEADERMAP_SUFFIXES", []))
+    headers = []
+    for root in _swift_headermap_dirs(env, node):
+        stack = [(root, "")]
+        while stack:
+            d, prefix = stack.pop()
+            for entry in d.glob("*"):
+                entry = entry.disambiguate()
+                if isinstance(entry, SCons.Node.FS.Dir):
+                    stack.append((entry, prefix + entry.name + "/"))
+                elif SCons.Util.splitext(entry.name)[1] in suffixes:
+                    headers.append((prefix + entry.name, entry))
+    return headers
+
+def _swift_headermap_scan(node, env, path):
+    return [header for _, header in _swift_known_headers(env, node)]
+
+SwiftHeaderMapScanner = SCons.Scanner.ScannerBase(
+    _swift_headermap_scan,
+    name="SwiftHeaderMapScanner",
+)
+
+def _swift_hash_headermap_key(key):
+    h = 0
+    for c in key.lower().encode():
+        h = (h + c * 13) & 0xFFFFFFFF
+    return h
+
+def _swift_write_headermap(path, entries):
+    """Write a Clang header map mapping include names to file paths"""
+    import struct
+
+    num_buckets = 8
+    while num_buckets * 3 < len(entries) * 4:
+        num_buckets *= 2
+
+    strings = bytearray(b"\0")
+
+    def add_string(s):
+        offset = len(strings)
+        strings.extend(s.encode() + b"\0")
+        return offset
+
+    buckets = [(0, 0, 0)] * num_buckets
+    max_value_length = 0
+    for key, value in entries:
+        prefix, suffix = os.path.split(value)
+        i = _swift_hash_headermap_key(key) & (num_buckets - 1)
+        while buckets[i][0]:
+            i = (i + 1) & (num_buckets - 1)
+        buckets[i] = (add_string(key), add_string(prefix + os.sep), add_string(suffix))
+        max_value_length = max(max_value_length, len(value))
+
+    strings_offset = 24 + 12 * num_buckets
+    with open(path, "wb") as f:
+        f.write(
+            struct.pack(
+                "<IHHIIII",
+                0x686D6170,  # 'hmap'
+                1,
+                0,
+                strings_offset,
+                len(entries),
+                num_buckets,
+                max_value_length,
+            )
+        )
+        for bucket in buckets:
+            f.write(struct.pack("<III", *bucket))
+        f.write(strings)
+
+def _swift_headermap(target, source, env):
+    entries = []
+    seen = set()
+    for name, header in _swift_known_headers(env, target[0]):
+        if name.lower() not in seen:
+            seen.add(name.lower())
+            entries.append((name, header.get_abspath()))
+    _swift_write_headermap(target[0].get_abspath(), entries)
+    return 0
+
+def _swift_headermap_flags(target, source, env, for_signature):
+    """Put the header map first in the search path and pass the module maps
+    of SWIFT_CLANG_HEADERMAP_PATH, whose directories are not searched"""
+    headermap = env.get("_SWIFT_CLANG_HEADERMAP")
+    if not headermap or not target:
+        return []
+
+    flags = ["-I", headermap.get_abspath()]
+    for d in SCons.Scanner.FindPathDirs("SWIFT_CLANG_HEADERMAP_PATH")(env, target[0].cwd):
+        modulemap = d.File("module.modulemap")
+        if modulemap.exists() or modulemap.is_derived():
+            flags += ["-Xcc", "-fmodule-map-file=" + modulemap.get_abspath()]
+    return flags
+
+def _swift_opt_record_flags(target, source, env, for_signature):
+    if not env.get("SWIFT_OPTIMIZATION_RECORD") or env.get("SWIFT_TYPECHECK_ONLY"):
+        return []
+
+    # Assembly vision remarks report the retains and releases left after
+    # optimization, for the "surviving ARC operations" category
+    flags = ["-save-optimization-record=yaml", "-Xllvm", "-enable-assembly-vision"]
+    passes = env.get("SWIFT_OPTIMIZATION_RECORD_PASSES")
+    if passes:
+        flags += ["-save-optimization-record-passes", passes]
+    module_suffix = env.subst("$SWIFTMODULESUFFIX")
+    if env.get("_SWIFT_OPT_RECORD_PER_SOURCE") or str(target[0]).endswith(module_suffix):
+        # Module compiles run in the source directory, which gets the records
+        return flags
+    records = _swift_opt_record_outputs(target, source, env)
+    if len(records) == 1:
+        flags += ["-save-optimization-record-path", records[0].get_abspath()]
+    else:
+        flags += [
+            "-output-file-map",
+            target[0].get_abspath() + env.subst("$SWIFTOUTPUTFILEMAPSUFFIX"),
+        ]
+    return flags
+
+def _swift_write_output_file_map(target, source, env):
+    with open(target[0].get_abspath(), "w") as f:
+        f.write(source[0].read())
+    return 0
+
+def _swift_opt_record_scan(node, env, path):
+    return [output for output, _ in _swift_opt_records]
+
+SwiftOptimizationReportScanner = SCons.Scanner.ScannerBase(
+    _swift_opt_record_scan,
+    name="SwiftOptimizationReportScanner",
+)
+
+def _swift_parse_opt_records(text):
+    """Yield (kind, pass, name, function, message) for each remark of a YAML
+    optimization record, as written by swiftc and clang"""
+    for doc in text.split("\n--- !"):
+        doc = doc.lstrip("-! ")
+        lines = doc.splitlines()
+        if not lines:
+            continue
+        kind = lines[0].strip()
+        fields = {}
+        message = []
+        for line in lines[1:]:
+            if line[:1] not in (" ", "") and ":" in line:
+                key, value = line.split(":", 1)
+                fields[key.strip()] = value.strip().strip("'\"")
+            elif line.startswith("  - ") and ":" in line:
+                message.append(line.split(":", 1)[1].strip().strip("'\""))
+        yield (
+            kind,
+            fields.get("Pass", ""),
+            fields.get("Name", ""),
+            fields.get("Function", ""),
+            "".join(message),
+        )
+
+def _swift_categorize_remark(kind, pass_name, name, message):
+    text = (pass_name + " " + name + " " + message).lower()
+    if "retain" in text or "release" in text or "assembly-vision" in text:
+        return "surviving ARC operations"
+    if kind != "Missed":
+        return None
+    if "inline" in text:
+        return "missed inlines"
+    if "specializ" in text or "generic" in text:
+        return "unspecialized generics"
+    return "other missed optimizations"
+
+def _swift_demangle(env, names):
+    """Demangle Swift symbols with swift-demangle, when it is available"""
+    import subprocess
+
+    demangle = env.WhereIs(env.subst("$SWIFT_DEMANGLE"))
+    if not names or not demangle:
+        return {}
+    result = subprocess.run(
+        [demangle, "--simplified"],
+        input="\n".join(names),
+        env={k: str(v) for k, v in env["ENV"].items()},
+        capture_output=True,
+        text=True,
+    )
+    if result.returncode != 0:
+        return {}
+    return dict(zip(names, result.stdout.splitlines()))
+
+def _swift_optimization_report(target, source, env):
+    """Rank the functions of each module by missed optimizations"""
+    counts = {}
+    for output, records in _swift_opt_records:
+        module = os.path.basename(SCons.Util.splitext(str(output))[0])
+        for record in records:
+            path = record.get_abspath()
+            if not os.path.exists(path):
+                SCons.Warnings.warn(
+                    SCons.Warnings.WarningOnByDefault,
+                    "%s: optimization record %s was not written" % (output, record),
+                )
+                continue
+            with open(path, errors="replace") as f:
+                text = f.read()
+            for kind, pass_name, name, function, message in _swift_parse_opt_records(text):
+                category = _swift_categorize_remark(kind, pass_name, name, message)
+                if category:
+                    key = (category, module, function)
+                    counts[key] = counts.get(key, 0) + 1
+
+    names = _swift_demangle(env, sorted({key[2] for key in counts if key[2].startswith("$s")}))
+    top = int(env.get("SWIFT_OPTIMIZATION_REPORT_TOP", 20))
+    with open(target[0].get_abspath(), "w") as f:
+        for category in (
+            "missed inlines",
+            "unspecialized generics",
+            "surviving ARC operations",
+            "other missed optimizations",
+        ):
+            ranked = sorted(
+                ((n, key) for key, n in counts.items() if key[0] == category),
+                key=lambda item: (-item[0], item[1]),
+            )
+            f.write("# %s: %d remark(s)\n" % (category, sum(n for n, _ in ranked)))
+            for n, (_, module, function) in ranked[:top]:
+                f.write("%6d  %s  %s\n" % (n, module, names.get(function, function)))
+            f.write("\n")
+    return 0
+
+def _swift_size_emitter(target, source, env):
+    """Register a linked program or library with SwiftSizeReport"""
+    if not env.get("SWIFT_TYPECHECK_ONLY"):
+        for t in target:
+            if t not in _swift_size_artifacts:
+                _swift_size_artifacts.append(t)
+    return target, source
+
+def _swift_size_report_emitter(target, source, env):
+    # The previous breakdown is kept to diff against
+    data = env.File(str(target[0]) + ".json")
+    env.Precious(data)
+    return target + [data], source
+
+def _swift_size_report_scan(node, env, path):
+    return list(_swift_size_artifacts)
+
+SwiftSizeReportScanner = SCons.Scanner.ScannerBase(
+    _swift_size_report_scan,
+    name="SwiftSizeReportScanner",
+)
+
+# Mangled Swift symbols ($s, _$s): the standard library module is "s" and
+# standard substitutions start with "S", other modules are length-prefixed
+_swift_mangled_swift_re = re.compile(r"^_?\$s(?:([sS])|(\d+))?")
+# Itanium C++ symbols (_Z, __Z), optionally a vtable, typeinfo or VTT, then
+# either a std:: substitution or, for a nested name, its outermost namespace
+_swift_mangled_cxx_re = re.compile(r"^__?Z(?:T[VTIS])?(N[rVKRO]*)?(?:(S[tabsiod])|(\d+))?")
+
+def _swift_symbol_module(name):
+    """Return the module or namespace a mangled symbol belongs to"""
+    match = _swift_mangled_swift_re.match(name)
+    if match:
+        if match.group(1):
+            return "Swift"
+        if match.group(2):
+            start = match.end()
+            return name[start : start + int(match.group(2))] or "(swift)"
+        return "(swift)"
+    match = _swift_mangled_cxx_re.match(name)
+    if match:
+        if match.group(2):
+            return "libstdc++"
+        if match.group(1) and match.group(3):
+            start = match.end()
+            return name[start : start + int(match.group(3))] or "(c++)"
+        return "(c++)"
+    return "(c)"
+
+def _swift_size_breakdown(env, path):
+    """Return {"sections": {name: size}, "symbols": {name: size}} of a binary"""
+    import subprocess
+
+    environ = {k: str(v) for k, v in env["ENV"].items()}
+    sections = {}
+    cmd = _swift_subst_args(env, "$SWIFT_LLVM_SIZE -A") + [path]
+    result = subprocess.run(cmd, env=environ, capture_output=True, text=True)
+    for line in result.stdout.splitlines():
+        # "section size addr", for ELF and Mach-O alike
+        fields = line.split()
+        if len(fields) == 3 and fields[1].isdigit() and fields[2].isdigit():
+            sections[fields[0]] = sections.get(fields[0], 0) + int(fields[1])
+
+    symbols = {}
+    cmd = _swift_subst_args(env, "$SWIFT_LLVM_NM --print-size --size-sort --radix=d") + [path]
+    result = subprocess.run(cmd, env=environ, capture_output=True, text=True)
+    for line in result.stdout.splitlines():
+        fields = line.split()
+        if len(fields) == 4 and fields[1].isdigit() and fields[2] in "tTdDbBrR":
+            symbols[fields[3]] = symbols.get(fields[3], 0) + int(fields[1])
+
+    if result.returncode != 0 and not sections:
+        return None
+    return {"sections": sections, "symbols": symbols}
+
+def _swift_size_delta(new, old):
+    if old is None:
+        return ""
+    return " (%+d)" % (new - old)
+
+def _swift_size_report(target, source, env):
+    """Break down the size of every program and library by section, module and symbol"""
+    import json
+
+    report, data = target[0].get_abspath(), target[1].get_abspath()
+    previous = {}
+    if os.path.exists(data):
+        with open(data) as f:
+            previous = json.load(f)
+
+    current = {}
+    for artifact in _swift_size_artifacts:
+        path = artifact.get_abspath()
+        if os.path.exists(path):
+            breakdown = _swift_size_breakdown(env, path)
+            if breakdown is not None:
+                current[artifact.path] = breakdown
+
+    top = int(env.get("SWIFT_SIZE_REPORT_TOP", 20))
+    with open(report, "w") as f:
+        for name, breakdown in sorted(current.items()):
+            old = previous.get(name)
+            sections, symbols = breakdown["sections"], breakdown["symbols"]
+            old_sections = old["sections"] if old else {}
+            old_symbols = old["symbols"] if old else {}
+
+            total = sum(sections.values())
+            f.write("# %s: %d bytes%s\n" % (
+                name, total, _swift_size_delta(total, sum(old_sections.values()) if old else None)))
+            for section, size in sorted(sections.items(), key=lambda item: -item[1]):
+                f.write("  %-24s %10d%s\n" % (
+                    section, size, _swift_size_delta(size, old_sections.get(section, 0) if old else None)))
+
+            modules, old_modules = {}, {}
+            for symbol, size in symbols.items():
+                module = _swift_symbol_module(symbol)
+                modules[module] = modules.get(module, 0) + size
+            for symbol, size in old_symbols.items():
+                module = _swift_symbol_module(symbol)
+                old_modules[module] = old_modules.get(module, 0) + size
+            f.write("  modules:\n")
+            for module, size in sorted(modules.items(), key=lambda item: -item[1]):
+                f.write("    %-22s %10d%s\n" % (
+                    module, size, _swift_size_delta(size, old_modules.get(module, 0) if old else None)))
+
+            f.write("  top symbols:\n")
+            for symbol, size in sorted(symbols.items(), key=lambda item: -item[1])[:top]:
+                f.write("    %10d%s  %s\n" % (
+                    size, _swift_size_delta(size, old_symbols.get(symbol, 0) if old else None), symbol))
+
+            if old:
+                grown = sorted(
+                    ((size - old_symbols.get(symbol, 0), symbol) for symbol, size in symbols.items()),
+                    reverse=True,
+                )
+                f.write("  largest growth:\n")
+                for delta, symbol in grown[:top]:
+                    if delta <= 0:
+                        break
+                    f.write("    %+10d  %s\n" % (delta, symbol))
+            f.write("\n")
+
+    with open(data, "w") as f:
+        json.dump(current, f, indent=1, sort_keys=True)
+    return 0
+
+def _swift_cxx_pchs_used(env, target, source):
+    """Return the SWIFT_CXX_PCH nodes whose header is included by a C++ object"""
+    if not target or not source:
+        return []
+    if SCons.Util.splitext(str(source[0]))[1] not in SCons.Tool.CXXSuffixes:
+        return []
+    pchs = env.get("SWIFT_CXX_PCH")
+    if not pchs:
+        return []
+
+    implicit = target[0].implicit or []
+    return [
+        pch
+        for pch in env.Flatten(pchs)
+        if pch.sources and pch.sources[0] in implicit
+    ]
+
+def _swift_cxx_pch_scan(node, env, path):
+    """Make C++ objects including a precompiled Swift header depend on its PCH"""
+    return _swift_cxx_pchs_used(env, [node], node.sources)
+
+SwiftCxxPchScanner = SCons.Scanner.ScannerBase(
+    _swift_cxx_pch_scan,
+    name="SwiftCxxPchScanner",
+)
+
+def _swift_cxx_pch_flags(target, source, env, for_signature):
+    flags = []
+    for pch in _swift_cxx_pchs_used(env, target, source):
+        flags += [env.subst("$SWIFT_CXX_PCH_FLAG"), pch]
+    return flags
+
+def SwiftCxxHeaderPch(env, header, **kw):
+    """Precompile a generated -Swift.h header for the C++ objects of `env`.
+
+    The PCH is built with the flags of `env`, so it matches the objects that
+    use it, and is added to SWIFT_CXX_PCH. Only objects which include the
+    header get -include-pch, and they depend on the PCH.
+    """
+    header = env.File(header)
+    pch = env._SwiftCxxHeaderPch(header.name + env.subst("$SWIFTPCHSUFFIX"), header, **kw)
+    env.Append(SWIFT_CXX_PCH=pch)
+    return pch
+
+def _swift_needs_single_compile(env):
+    """Whether the module and objects must come from one compile.
+
+    With CMO, or optimizing in whole-module mode, the SIL serialized into
+    the module has to match the linkage decisions made in the objects.
+    """
+    if env.get("SWIFT_CROSS_MODULE_OPTIMIZATION"):
+        return True
+    flags = _swift_optimization_flags(env)
+    return _swift_is_whole_module(flags) and any(f in _SWIFT_OPTIMIZE_FLAGS for f in flags)
+
+def SwiftStaticLibrary(env, target, source, **kw):
+    """Build a Swift module and archive its objects into a static library.
+
+    The module (with its generated header) and the objects are emitted by
+    two independent actions, which can run in parallel, and the objects
+    are archived without having to be listed. With cross-module or
+    optimized whole-module builds they come from a single SwiftModule
+    compile instead. With SWIFT_THIN_ARCHIVE the archive only references
+    the objects.
+    """
+    name = SCons.Util.splitext(env.arg2nodes(target)[0].name)[0]
+    kw.setdefault("SWIFTMODULENAME", env.get("SWIFTMODULENAME") or name)
+    source = env.arg2nodes(source, env.fs.File)
+
+    if env.get("SWIFT_TYPECHECK_ONLY"):
+        return env.SwiftModule(target, source, **kw)
+
+    if _swift_needs_single_compile(env.Override(kw)):
+        nodes = env.SwiftModule(target, source, **kw)
+        objects = [n for n in nodes if n.get_suffix() == ".o"]
+        module = [n for n in nodes if n.get_suffix() != ".o"]
+    else:
+        module = env._SwiftEmitModule(target, source, **kw)
+        objects = env._SwiftObjects(
+            [SCons.Util.splitext(s.name)[0] + env.subst("$SWIFTOBJSUFFIX") for s in source],
+            source,
+            **kw
+        )
+
+    if env.get("SWIFT_THIN_ARCHIVE"):
+        if env["PLATFORM"] == "darwin":
+            SCons.Warnings.warn(
+                SCons.Warnings.WarningOnByDefault,
+                "SWIFT_THIN_ARCHIVE is not supported by the Darwin archiver, "
+                "building a regular archive for %s" % name,
+            )
+        else:
+            kw["ARFLAGS"] = env.subst("$SWIFTTHINARFLAGS")
+    lib = env.StaticLibrary(target, objects, **kw)
+    return lib + module
+
+def _swift_subst_args(env, string):
+    """Substitute `string` into a list of command line arguments"""
+    cmds = env.subst_list(string, SCons.Subst.SUBST_CMD)
+    return [str(arg) for arg in cmds[0]] if cmds else []
+
+def _swift_target_info(env):
+    """Return the output of swiftc -print-target-info"""
+    import json
+    import subprocess
+
+    cmd = _swift_subst_args(env, "$SWIFT -print-target-info $SWIFTFLAGS")
+    environ = {k: str(v) for k, v in env["ENV"].items()}
+    result = subprocess.run(cmd, env=environ, capture_output=True, text=True)
+    if result.returncode != 0:
+        return None
+    return json.loads(result.stdout)
+
+def _swift_find_interfaces(dirs, module_triple):
+    """Return (name, path) of the modules in `dirs` only shipped as .swiftinterface"""
+    interfaces = {}
+    for top in dirs:
+        for root, subdirs, files in os.walk(top):
+            if root.endswith(".swiftmodule"):
+                # Module directory: <Name>.swiftmodule/<triple>.swiftinterface
+                subdirs[:] = []
+                interface = module_triple + ".swiftinterface"
+                binary = module_triple + ".swiftmodule"
+                if interface in files and binary not in files:
+                    name = os.path.basename(root)[: -len(".swiftmodule")]
+                    interfaces.setdefault(name, os.path.join(root, interface))
+                continue
+
+            for f in files:
+                name, ext = os.path.splitext(f)
+                if ext != ".swiftinterface" or name.endswith(".private"):
+                    continue
+                if name + ".swiftmodule" not in files:
+                    interfaces.setdefault(name, os.path.join(root, f))
+    return sorted(interfaces.items())
+
+def _swift_prebuilt_modules(target, source, env):
+    """Compile interface-only toolchain modules into the prebuilt module cache"""
+    import concurrent.futures
+    import subprocess
+
+    info = _swift_target_info(env)
+    if not info:
+        print("swift: unable to query the target info of %s" % env.subst("$SWIFT"))
+        return 1
+
+    cache = target[0].dir.get_abspath()
+    module_triple = info["target"].get("moduleTriple", info["target"]["triple"])
+    dirs = [info["paths"]["runtimeResourcePath"]]
+    if info["paths"].get("sdkPath"):
+        dirs.append(os.path.join(info["paths"]["sdkPath"], "usr", "lib", "swift"))
+
+    swift = _swift_subst_args(env, "$SWIFT")
+    flags = _swift_subst_args(env, "$SWIFTPREBUILTMODULEFLAGS")
+    environ = {k: str(v) for k, v in env["ENV"].items()}
+
+    def compile(name, interface):
+        # Same layout as the interface, where the compiler looks for it:
+        # <Name>.swiftmodule/<triple>.swiftmodule for a module directory,
+        # a flat <Name>.swiftmodule otherwise
+        output = os.path.join(cache, name + ".swiftmodule")
+        if os.path.basename(os.path.dirname(interface)) == name + ".swiftmodule":
+            output = os.path.join(output, module_triple + ".swiftmodule")
+        if os.path.exists(output) and os.path.getmtime(output) >= os.path.getmtime(interface):
+            return True
+        os.makedirs(os.path.dirname(output), exist_ok=True)
+        cmd = (
+            swift
+            + ["-frontend", "-compile-module-from-interface", "-module-name", name]
+            + ["-o", output, interface, "-prebuilt-module-cache-path", cache]
+            + flags
+        )
+        result = subprocess.run(cmd, env=environ, capture_output=True, text=True)
+        return result.returncode == 0
+
+    # Interfaces import each other, so retry the failures while any succeed
+    pending = _swift_find_interfaces(dirs, module_triple)
+    built = []
+    jobs = int(env.get("SWIFT_PREBUILT_MODULE_JOBS") or os.cpu_count() or 1)
+    with concurrent.futures.ThreadPoolExecutor(max_workers=jobs) as pool:
+        while pending:
+            results = list(pool.map(lambda item: compile(*item), pending))
+            done = [item for item, ok in zip(pending, results) if ok]
+            if not done:
+                break
+            built += done
+            pending = [item for item, ok in zip(pending, results) if not ok]
+
+    with open(target[0].get_abspath(), "w") as f:
+        for name, interface in sorted(built):
+            f.write("%s %s\n" % (name, interface))
+        for name, interface in pending:
+            f.write("%s %s (failed)\n" % (name, interface))
+    for name, _ in pending:
+        print("swift: could not prebuild module %s" % name)
+    return 0
+
+def _swift_prebuilt_module_cache_flags(target, source, env, for_signature):
+    cache = env.get("SWIFT_PREBUILT_MODULE_CACHE")
+    if not cache:
+        return []
+    return [
+        "-Xfrontend",
+        "-prebuilt-module-cache-path",
+        "-Xfrontend",
+        env.Dir(cache).get_abspath(),
+    ]
+
+def SwiftPrebuiltModules(env, cache_root=None):
+    """Prebuild the toolchain modules only shipped as .swiftinterface files.
+
+    The cache lives in a directory of `cache_root` keyed by the compiler,
+    its version and SWIFTPREBUILTMODULEFLAGS, so it can be kept across
+    clean builds and shared by CI jobs. The environment (and its clones)
+    then pass it to every Swift action with -prebuilt-module-cache-path.
+    """
+    import hashlib
+
+    key = "\n".join(
+        [
+            env.subst("$SWIFT"),
+            _swift_version_string(env),
+            env.subst("$SWIFTPREBUILTMODULEFLAGS"),
+        ]
+    )
+    root = env.Dir(cache_root or "$SWIFT_PREBUILT_MODULE_CACHE_ROOT")
+    cache = root.Dir(hashlib.sha1(key.encode()).hexdigest()[:16])
+    manifest = env._SwiftPrebuiltModules(cache.File("modules.txt"), [])
+    env.NoClean(manifest)
+    env.Alias("swift-prebuilt-modules", manifest)
+
+    env["SWIFT_PREBUILT_MODULE_CACHE"] = cache
+    env["_SWIFT_PREBUILT_MODULES"] = manifest
+    return manifest
+
+# Expanded -I, -F and -L flags, keyed by the prefix, paths, suffix and
+# directory they are relative to
+_swift_path_flags_cache = {}
+
+def _swift_path_flags(prefix_var, paths_var, suffix_var):
+    """Return a construction variable callable equivalent to
+    `$( ${_concat(prefix, paths, suffix, __env__, RDirs, TARGET, SOURCE)} $)`.
+
+    The expansion only depends on the variables and on the directory
+    relative paths are looked up from, so it is computed once for each
+    of them instead of for every command line and signature. Values that
+    still need substitution are expanded every time.
+    """
+
+    def path_flags(target, source, env, for_signature):
+        if for_signature:
+            # Like $( $): search paths do not affect the signature
+            return []
+
+        prefix = env.get(prefix_var, "")
+        suffix = env.get(suffix_var, "")
+        paths = SCons.Util.flatten(env.get(paths_var) or [])
+        node = target[0] if target else None
+        cwd = (node and node.cwd) or env.fs._cwd
+
+        key = (prefix, suffix, tuple(paths), cwd)
+        cacheable = not any(
+            "$" in p for p in (prefix, suffix) + key[2] if SCons.Util.is_String(p)
+        )
+        if cacheable and key in _swift_path_flags_cache:
+            return list(_swift_path_flags_cache[key])
+
+        prefix = str(env.subst(prefix, SCons.Subst.SUBST_RAW))
+        suffix = str(env.subst(suffix, SCons.Subst.SUBST_RAW))
+        paths = [
+            p for p in env.subst_path(paths, target=target, source=source) if p
+        ]
+        flags = []
+        for d in cwd.Rfindalldirs(paths):
+            if prefix.endswith(" ") or suffix.startswith(" "):
+                flags += [a for a in (prefix.strip(), str(d), suffix.strip()) if a]
+            else:
+                flags.append(prefix + str(d) + suffix)
+
+        if cacheable:
+            # Stored as a tuple so a caller appending to its copy cannot
+            # change the flags handed to other environments
+            _swift_path_flags_cache[key] = tuple(flags)
+        return flags
+
+    return path_flags
+
+def _swift_module_cache_flags(target, source, env, for_signature):
+    cache = env.get("SWIFT_MODULE_CACHE_PATH")
+    if not cache:
+        return []
+    return ["-module-cache-path", env.Dir(cache).get_abspath()]
+
+def SwiftVariant(env, name, **overrides):
+    """Return a clone of `env` configured for the build variant `name`.
+
+    The flags come from SWIFT_VARIANTS[name] and `overrides`. Each variant
+    gets its own Clang module cache, while the toolchain detection, the
+    prebuilt module cache and the import scan results stay shared with
+    the other variants of the invocation.
+    """
+    variants = env.get("SWIFT_VARIANTS", {})
+    if name not in variants:
+        raise SCons.Errors.UserError(
+            "Unknown Swift variant %r, expected one of: %s"
+            % (name, ", ".join(sorted(variants)))
+        )
+
+    variant = env.Clone()
+    variant["SWIFT_VARIANT"] = name
+    variant["SWIFT_MODULE_CACHE_PATH"] = variant.Dir("$SWIFT_MODULE_CACHE_ROOT/" + name)
+    variant.Append(**variants[name])
+    variant.Append(**overrides)
+    return variant
+
+# Builders shared by every environment the tool is applied to
+_swift_builders = {}
+
+def _swift_create_builders():
+    """Create the Swift builders once, on the first generate()"""
+    if _swift_builders:
+        return _swift_builders
+    builders = {}
+
+    # Swift Module Builder
+    swift_module_builder = SCons.Builder.Builder(
+        generator=_swift_module_generator,
+        suffix="$SWIFTMODULESUFFIX",
+        src_suffix=SwiftSuffixes,
+        source_scanner=SwiftScanner,
+        emitter=[
+            _swift_cxx_header_emitter,
+            _swift_obj_emitter,
+            _swift_emitter,
+            _swift_check_emitter,
+            _swift_typecheck_report_emitter,
+            _swift_headermap_emitter,
+            _swift_prebuilt_modules_emitter,
+            _swift_cmo_emitter,
+            _swift_module_opt_record_emitter,
+        ],
+        chdir=True,
+        single_source=0,
+        _SWIFTCHECKBUILDERFLAGS="$SWIFTMODULEFLAGS",
+    )
+    builders["SwiftModule"] = swift_module_builder
+
+    # Module, doc and generated header of SwiftStaticLibrary
+    swift_emit_module_builder = SCons.Builder.Builder(
+        generator=_swift_emit_module_generator,
+        suffix="$SWIFTMODULESUFFIX",
+        src_suffix=SwiftSuffixes,
+        source_scanner=SwiftScanner,
+        emitter=[
+            _swift_cxx_header_emitter,
+            _swift_emitter,
+            _swift_headermap_emitter,
+            _swift_prebuilt_modules_emitter,
+            _swift_cmo_emitter,
+        ],
+        chdir=True,
+        single_source=0,
+    )
+    builders["_SwiftEmitModule"] = swift_emit_module_builder
+
+    # Objects of SwiftStaticLibrary, one per source
+    swift_objects_builder = SCons.Builder.Builder(
+        generator=_swift_objects_generator,
+        src_suffix=SwiftSuffixes,
+        source_scanner=SwiftScanner,
+        emitter=[
+            _swift_headermap_emitter,
+            _swift_prebuilt_modules_emitter,
+            _swift_module_opt_record_emitter,
+        ],
+        chdir=True,
+        single_source=0,
+        _SWIFT_OPT_RECORD_PER_SOURCE=True,
+    )
+    builders["_SwiftObjects"] = swift_objects_builder
+
+    # Swift Library Builder
+    swift_lib_builder = SCons.Builder.Builder(
+        generator=_swift_lib_generator,
+        suffix="$SHLIBSUFFIX",
+        src_suffix=SwiftSuffixes,
+        source_scanner=SwiftScanner,
+        emitter=[
+            _swift_check_emitter,
+            _swift_typecheck_report_emitter,
+            _swift_headermap_emitter,
+            _swift_prebuilt_modules_emitter,
+            _swift_cmo_emitter,
+            _swift_opt_record_emitter,
+            _swift_size_emitter,
+            _swift_split_debug_emitter,
+        ],
+        single_source=0,
+        _SWIFTCHECKBUILDERFLAGS="$SWIFTLIBFLAGS",
+        _SWIFT_OPT_RECORD_CMO=True,
+    )
+    builders["SwiftLibrary"] = swift_lib_builder
+
+    # Swift Program Builder
+    swift_exe_builder = SCons.Builder.Builder(
+        generator=_swift_exe_generator,
+        suffix="$PROGSUFFIX",
+        src_suffix=SwiftSuffixes,
+        source_scanner=SwiftScanner,
+        emitter=[
+            _swift_check_emitter,
+            _swift_typecheck_report_emitter,
+            _swift_headermap_emitter,
+            _swift_prebuilt_modules_emitter,
+            _swift_opt_record_emitter,
+            _swift_size_emitter,
+            _swift_split_debug_emitter,
+        ],
+        single_source=0,
+        _SWIFTCHECKBUILDERFLAGS="$SWIFTEXEFLAGS",
+    )
+    builders["SwiftProgram"] = swift_exe_builder
+
+    # Swift Typecheck Builder
+    swift_check_builder = SCons.Builder.Builder(
+        generator=_swift_check_generator,
+        suffix="$SWIFTCHECKSUFFIX",
+        src_suffix=SwiftSuffixes,
+        source_scanner=SwiftScanner,
+        emitter=[
+            _swift_typecheck_report_emitter,
+            _swift_headermap_emitter,
+            _swift_prebuilt_modules_emitter,
+        ],
+        single_source=0,
+    )
+    builders["SwiftCheck"] = swift_check_builder
+
+    # Prebuilt module cache builder, used through SwiftPrebuiltModules
+    swift_prebuilt_modules_builder = SCons.Builder.Builder(
+        action=SCons.Action.Action(
+            _swift_prebuilt_modules, "Prebuilding Swift modules in ${TARGET.dir}"
+        ),
+    )
+    builders["_SwiftPrebuiltModules"] = swift_prebuilt_modules_builder
+
+    # Clang header map builder
+    swift_headermap_builder = SCons.Builder.Builder(
+        action=SCons.Action.Action(_swift_headermap, "Generating header map $TARGET"),
+        suffix="$SWIFTHEADERMAPSUFFIX",
+        target_scanner=SwiftHeaderMapScanner,
+    )
+    builders["SwiftHeaderMap"] = swift_headermap_builder
+
+    # Output file map of a Swift program or library, from a Value of its JSON
+    swift_output_file_map_builder = SCons.Builder.Builder(
+        action=SCons.Action.Action(
+            _swift_write_output_file_map, "Generating output file map $TARGET"
+        ),
+        suffix="$SWIFTOUTPUTFILEMAPSUFFIX",
+    )
+    builders["_SwiftOutputFileMap"] = swift_output_file_map_builder
+
+    # Precompiled generated C++ header builder, used through SwiftCxxHeaderPch
+    swift_pch_builder = SCons.Builder.Builder(
+        action=SCons.Action.Action("$SWIFTPCHCOM", "$SWIFTPCHCOMSTR"),
+        suffix="$SWIFTPCHSUFFIX",
+        source_scanner=SCons.Tool.CScanner,
+    )
+    builders["_SwiftCxxHeaderPch"] = swift_pch_builder
+
+    # Generated C++ header report builder
+    swift_cxx_header_report_builder = SCons.Builder.Builder(
+        action=SCons.Action.Action(
+            _swift_cxx_header_report, "Reporting on C++ header $SOURCE"
+        ),
+        suffix="$SWIFTCXXHEADERREPORTSUFFIX",
+    )
+    builders["SwiftCxxHeaderReport"] = swift_cxx_header_report_builder
+
+    # Optimization report builder
+    swift_optimization_report_builder = SCons.Builder.Builder(
+        action=SCons.Action.Action(
+            _swift_optimization_report, "Writing optimization report $TARGET"
+        ),
+        target_scanner=SwiftOptimizationReportScanner,
+    )
+    builders["SwiftOptimizationReport"] = swift_optimization_report_builder
+
+    # Size report builder, covering the C and C++ programs and libraries too
+    swift_size_report_builder = SCons.Builder.Builder(
+        action=SCons.Action.Action(_swift_size_report, "Writing size report $TARGET"),
+        emitter=_swift_size_report_emitter,
+        target_scanner=SwiftSizeReportScanner,
+    )
+    builders["SwiftSizeReport"] = swift_size_report_builder
+
+    # Stripped artifact and separate debug info builder
+    swift_split_debug_builder = SCons.Builder.Builder(
+        action=[
+            SCons.Action.Action("$SWIFTDEBUGCOM", "$SWIFTDEBUGCOMSTR"),
+            SCons.Action.Action("$SWIFTSTRIPCOM", "$SWIFTSTRIPCOMSTR"),
+        ],
+    )
+    builders["_SwiftSplitDebug"] = swift_split_debug_builder
+
+    _swift_builders.update(builders)
+    return _swift_builders
+
 def _detect_swift_version(env, swift):
     """Detect Swift compiler version"""
     import subprocess
@@ -101,13 +1485,85 @@ def _detect_swift_version(env, swift):
         pass
     return None
 
+# Toolchain detection results, keyed by the PATH (or compiler) they depend on
+_swift_toolchain_cache = {}
+
+def _swift_memoized(key, detect):
+    if key not in _swift_toolchain_cache:
+        _swift_toolchain_cache[key] = detect()
+    return _swift_toolchain_cache[key]
+
+def _swift_compiler(target, source, env, for_signature):
+    """Default $SWIFT: the first compiler found in the PATH of the environment"""
+    path = env["ENV"].get("PATH", "")
+    return _swift_memoized(
+        ("SWIFT", path), lambda: env.Detect(compilers) or compilers[0]
+    )
+
+def _swift_version(target, source, env, for_signature):
+    """Default $SWIFTVERSION: the first line of `$SWIFT --version`"""
+    swift = env.subst("$SWIFT")
+    return _swift_memoized(
+        ("SWIFTVERSION", env.WhereIs(swift) or swift),
+        lambda: _detect_swift_version(env, swift) or "",
+    )
+
+def _swift_cc_is_clang(env):
+    """Whether both $CC and $CXX are Clang, from their --version"""
+    import subprocess
+
+    def detect(path):
+        try:
+            result = subprocess.run(
+                [path, "--version"],
+                capture_output=True,
+                text=True,
+                env={k: str(v) for k, v in env["ENV"].items()},
+            )
+        except OSError:
+            return False
+        return "clang" in result.stdout.lower()
+
+    for cc in (env.subst("$CC"), env.subst("$CXX")):
+        path = env.WhereIs(cc) or cc
+        if not cc or not _swift_memoized(("CLANG", path), lambda: detect(path)):
+            return False
+    return True
+
+def _swift_cc_opt_record_default_flags(target, source, env, for_signature):
+    """Default $SWIFT_CC_OPTIMIZATION_RECORD_FLAGS: Clang's remarks, none for other compilers"""
+    if _swift_cc_is_clang(env):
+        return ["-fsave-optimization-record", "-Rpass-missed=inline"]
+    return []
+
+def _swift_sdkroot(target, source, env, for_signature):
+    """Default $SDKROOT on Darwin: the SDK selected by xcrun"""
+    import subprocess
+
+    def detect():
+        try:
+            result = subprocess.run(
+                ["xcrun", "--show-sdk-path"], capture_output=True, text=True
+            )
+            if result.returncode == 0:
+                return result.stdout.strip()
+        except:
+            pass
+        return ""
+
+    developer_dir = env["ENV"].get("DEVELOPER_DIR", os.environ.get("DEVELOPER_DIR", ""))
+    return _swift_memoized(("SDKROOT", developer_dir), detect)
+
+def _swift_version_string(env):
+    """Return the compiler version, detecting it if needed"""
+    return env.subst("$SWIFTVERSION")
 
 def generate(env):
     """Add Builders and construction variables for Swift to an Environment."""
 
-    # Detect Swift compiler
+    # The compiler is only searched for when first substituted
     if "SWIFT" not in env:
-        env["SWIFT"] = env.Detect(compilers) or compilers[0]
+        env["SWIFT"] = _swift_compiler
 
     # Basic Swift variables
     env["SWIFTFLAGS"] = SCons.Util.CLVar("")
@@ -121,9 +1577,43 @@ def generate(env):
         '${SWIFT_CXX_INTEROP and "-cxx-interoperability-mode=default" or ""}'
     )
     env["_SWIFT_EMIT_CXX_HEADER_FLAG"] = (
-        '${SWIFT_EMIT_CXX_HEADER and "-emit-clang-header-path $_SWIFT_CXX_HEADER_NAME.abspath" or ""}'
+        '${SWIFT_EMIT_CXX_HEADER and "-emit-clang-header-path $_SWIFT_CXX_HEADER_NAME.abspath $_SWIFT_CXX_EXPOSE_DECLS_FLAG" or ""}'
+    )
+
+    # Declarations exposed in the generated header: "all-public" or
+    # "has-expose-attr" (only @_expose(Cxx) declarations), empty for the default
+    env["SWIFT_CXX_EXPOSE_DECLS"] = ""
+    env["_SWIFT_CXX_EXPOSE_DECLS_FLAG"] = (
+        '${SWIFT_CXX_EXPOSE_DECLS and "-Xfrontend -clang-header-expose-decls=$SWIFT_CXX_EXPOSE_DECLS" or ""}'
+    )
+
+    # Generated header size and parse time report
+    env["SWIFT_CXX_HEADER_REPORT"] = False
+    env["SWIFTCXXHEADERREPORTSUFFIX"] = ".report.txt"
+    env["SWIFTCXXHEADERREPORTRUNS"] = 3
+    env["SWIFTCXXHEADERPARSEFLAGS"] = SCons.Util.CLVar("-std=c++17")
+    env["SWIFTCXXHEADERPARSECOM"] = (
+        "$CXX -x c++ -fsyntax-only $SOURCE $SWIFTCXXHEADERPARSEFLAGS $CXXFLAGS $CCFLAGS $_CCCOMCOM"
     )
 
+    # Precompiled generated C++ headers, see SwiftCxxHeaderPch
+    env["SWIFT_CXX_PCH"] = []
+    env["SWIFT_CXX_PCH_FLAG"] = "-include-pch"
+    env["SWIFTPCHSUFFIX"] = ".pch"
+    env["SWIFTPCHFLAGS"] = SCons.Util.CLVar("")
+    env["SWIFTPCHCOM"] = (
+        "$CXX -x c++-header -o $TARGET $SOURCE $CXXFLAGS $CCFLAGS $_CCCOMCOM $SWIFTPCHFLAGS"
+    )
+    env["SWIFTPCHCOMSTR"] = env.get(
+        "SWIFTPCHCOMSTR", SCons.Action.Action("$SWIFTPCHCOM", "$SWIFTPCHCOMSTR")
+    )
+    env["_SWIFT_CXX_PCH_FLAGS"] = _swift_cxx_pch_flags
+
+    # Flags the tool adds to C and C++ compiles
+    env["_SWIFT_CCCOMCOM"] = "$_SWIFT_CXX_PCH_FLAGS $_SWIFT_CC_OPT_RECORD_FLAGS"
+    if "$_SWIFT_CCCOMCOM" not in env.get("_CCCOMCOM", ""):
+        env["_CCCOMCOM"] = env.get("_CCCOMCOM", "") + " $_SWIFT_CCCOMCOM"
+
     # Module support
     env["SWIFTMODULENAME"] = ""
     env["SWIFTMODULESUFFIX"] = ".swiftmodule"
@@ -133,32 +1623,125 @@ def generate(env):
     # Include paths (-I flag)
     env["INCPREFIX"] = "-I "
     env["INCSUFFIX"] = ""
-    env["_SWIFTINCFLAGS"] = (
-        "$( ${_concat(INCPREFIX, SWIFTPATH, INCSUFFIX, __env__, RDirs, TARGET, SOURCE)} $)"
-    )
+    env["_SWIFTINCFLAGS"] = _swift_path_flags("INCPREFIX", "SWIFTPATH", "INCSUFFIX")
 
     # Framework paths (-F flag)
     env["FRAMEWORKPREFIX"] = "-F "
     env["FRAMEWORKSUFFIX"] = ""
-    env["_SWIFTFRAMEWORKPATH"] = (
-        "$( ${_concat(FRAMEWORKPREFIX, FRAMEWORKPATH, FRAMEWORKSUFFIX, __env__, RDirs, TARGET, SOURCE)} $)"
+    env["_SWIFTFRAMEWORKPATH"] = _swift_path_flags(
+        "FRAMEWORKPREFIX", "FRAMEWORKPATH", "FRAMEWORKSUFFIX"
     )
 
     # Library paths (-L flag)
     env["SWIFTLIBDIRPREFIX"] = "-L "
     env["SWIFTLIBDIRSUFFIX"] = ""
-    env["_SWIFTLIBFLAGS"] = (
-        "$( ${_concat(SWIFTLIBDIRPREFIX, LIBPATH, SWIFTLIBDIRSUFFIX, __env__, RDirs, TARGET, SOURCE)} $)"
+    env["_SWIFTLIBFLAGS"] = _swift_path_flags(
+        "SWIFTLIBDIRPREFIX", "LIBPATH", "SWIFTLIBDIRSUFFIX"
     )
 
+    # Type-check time thresholds in milliseconds (0 disables them)
+    env["SWIFT_WARN_LONG_FUNCTION_MS"] = 0
+    env["SWIFT_WARN_LONG_EXPR_MS"] = 0
+    env["SWIFT_WARN_LONG_AS_ERROR"] = False
+    env["SWIFTTYPECHECKREPORTSUFFIX"] = ".typecheck.txt"
+    env["_SWIFT_TYPECHECK_TIMING_FLAGS"] = (
+        '${SWIFT_WARN_LONG_FUNCTION_MS and "-Xfrontend -warn-long-function-bodies=$SWIFT_WARN_LONG_FUNCTION_MS" or ""} '
+        '${SWIFT_WARN_LONG_EXPR_MS and "-Xfrontend -warn-long-expression-type-checking=$SWIFT_WARN_LONG_EXPR_MS" or ""}'
+    )
+
+    # Clang header map of the headers in SWIFTPATH and SWIFT_CLANG_HEADERMAP_PATH.
+    # Directories in SWIFT_CLANG_HEADERMAP_PATH are only reached through the
+    # header map and their module maps, so Clang does not search them.
+    env["SWIFT_CLANG_HEADERMAP"] = False
+    env["SWIFT_CLANG_HEADERMAP_PATH"] = SCons.Util.CLVar("")
+    env["SWIFT_CLANG_HEADERMAP_SUFFIXES"] = [
+        ".h", ".hh", ".hpp", ".hxx", ".inc", ".def", ".modulemap"
+    ]
+    env["SWIFTHEADERMAPSUFFIX"] = ".hmap"
+    env["_SWIFT_CLANG_HEADERMAP_FLAGS"] = _swift_headermap_flags
+
+    # Prebuilt module cache, see SwiftPrebuiltModules
+    env["SWIFT_PREBUILT_MODULE_CACHE"] = ""
+    env["SWIFT_PREBUILT_MODULE_CACHE_ROOT"] = "#.swift-prebuilt"
+    env["SWIFT_PREBUILT_MODULE_JOBS"] = 0
+    env["SWIFTPREBUILTMODULEFLAGS"] = SCons.Util.CLVar("")
+    env["_SWIFT_PREBUILT_MODULE_CACHE_FLAGS"] = _swift_prebuilt_module_cache_flags
+
+    # Optimization records: YAML remarks next to each output, aggregated by
+    # SwiftOptimizationReport
+    env["SWIFT_OPTIMIZATION_RECORD"] = False
+    env["SWIFT_OPTIMIZATION_RECORD_PASSES"] = ""
+    env["SWIFT_CC_OPTIMIZATION_RECORD_FLAGS"] = _swift_cc_opt_record_default_flags
+    env["SWIFT_OPTIMIZATION_REPORT_TOP"] = 20
+    env["SWIFT_DEMANGLE"] = "swift-demangle"
+    env["SWIFTOUTPUTFILEMAPSUFFIX"] = ".outputs.json"
+    env["_SWIFT_OPT_RECORD_FLAGS"] = _swift_opt_record_flags
+    env["_SWIFT_CC_OPT_RECORD_FLAGS"] = (
+        '${SWIFT_OPTIMIZATION_RECORD and "$SWIFT_CC_OPTIMIZATION_RECORD_FLAGS" or ""}'
+    )
+
+    # Split debug info: a stripped copy of each Swift program and library,
+    # plus its debug info found again by build-id or debug link
+    env["SWIFT_SPLIT_DEBUG_INFO"] = False
+    env["SWIFT_STRIPPED_DIR"] = "stripped"
+    env["SWIFT_OBJCOPY"] = "objcopy"
+    env["SWIFTDEBUGSUFFIX"] = ".debug"
+    env["SWIFTDEBUGCOM"] = "$SWIFT_OBJCOPY --only-keep-debug $SOURCE ${TARGETS[1]}"
+    env["SWIFTDEBUGCOMSTR"] = env.get(
+        "SWIFTDEBUGCOMSTR", SCons.Action.Action("$SWIFTDEBUGCOM", "$SWIFTDEBUGCOMSTR")
+    )
+    env["SWIFTSTRIPCOM"] = (
+        "$SWIFT_OBJCOPY --strip-debug --add-gnu-debuglink=${TARGETS[1]} $SOURCE $TARGET"
+    )
+    env["SWIFTSTRIPCOMSTR"] = env.get(
+        "SWIFTSTRIPCOMSTR", SCons.Action.Action("$SWIFTSTRIPCOM", "$SWIFTSTRIPCOMSTR")
+    )
+    env["_SWIFT_BUILD_ID_FLAGS"] = (
+        '${SWIFT_SPLIT_DEBUG_INFO and "-Xlinker --build-id" or ""}'
+    )
+
+    # Remote frontend jobs: "host:port" of workers (see worker.py)
+    env["SWIFT_WORKERS"] = []
+    env["SWIFT_WORKER_TIMEOUT"] = 0
+    env["SWIFT_WORKER_TOKEN"] = os.environ.get("SWIFT_WORKER_TOKEN", "")
+
+    # Size report: llvm-size and llvm-nm of every program and library
+    env["SWIFT_LLVM_SIZE"] = "llvm-size"
+    env["SWIFT_LLVM_NM"] = "llvm-nm"
+    env["SWIFT_SIZE_REPORT_TOP"] = 20
+
+    # Build variants, created with SwiftVariant
+    env["SWIFT_VARIANT"] = ""
+    env["SWIFT_VARIANTS"] = {
+        "debug": {"SWIFTFLAGS": ["-Onone", "-g"], "CCFLAGS": ["-O0", "-g"]},
+        "release": {"SWIFTFLAGS": ["-O"], "CCFLAGS": ["-O2"], "CPPDEFINES": ["NDEBUG"]},
+        "profile": {
+            "SWIFTFLAGS": ["-O", "-g"],
+            "CCFLAGS": ["-O2", "-g", "-fno-omit-frame-pointer"],
+            "CPPDEFINES": ["NDEBUG"],
+        },
+    }
+    env["SWIFT_MODULE_CACHE_ROOT"] = "#.swift-module-cache"
+    env["SWIFT_MODULE_CACHE_PATH"] = ""
+    env["_SWIFT_MODULE_CACHE_FLAGS"] = _swift_module_cache_flags
+
     # Common flags for both static and shared compilation
     env["_SWIFTCOMCOM"] = (
-        "$_SWIFTINCFLAGS $_SWIFTFRAMEWORKPATH $_SWIFTLIBFLAGS $_SWIFT_CXX_INTEROP_FLAG"
+        "$SWIFTFLAGS $_SWIFT_CLANG_HEADERMAP_FLAGS $_SWIFTINCFLAGS $_SWIFTFRAMEWORKPATH $_SWIFTLIBFLAGS $_SWIFT_CXX_INTEROP_FLAG $_SWIFT_TYPECHECK_TIMING_FLAGS $_SWIFT_PREBUILT_MODULE_CACHE_FLAGS $_SWIFT_MODULE_CACHE_FLAGS $_SWIFT_OPT_RECORD_FLAGS"
     )
 
+    # Cross-module optimization: "full" (-cross-module-optimization) or
+    # "default" (-enable-default-cmo), both in whole-module mode. SwiftModule,
+    # SwiftLibrary and SwiftStaticLibrary (which then uses one SwiftModule
+    # compile) emit the module from the optimized compile, so it carries the
+    # serialized SIL clients inline.
+    env["SWIFT_CROSS_MODULE_OPTIMIZATION"] = ""
+    env["SWIFT_WMO_THREADS"] = os.cpu_count() or 1
+    env["_SWIFT_CMO_FLAGS"] = _swift_cmo_flags
+
     # Library builder for Swift
     env["SWIFTLIBCOM"] = (
-        "$SWIFT -emit-library -o $TARGET $SOURCES $SWIFTLIBFLAGS $_SWIFTCOMCOM"
+        "$SWIFT -emit-library -o $TARGET $SOURCES $SWIFTLIBFLAGS $_SWIFT_CMO_FLAGS $_SWIFT_BUILD_ID_FLAGS $_SWIFTCOMCOM"
     )
     env["SWIFTLIBCOMSTR"] = env.get(
         "SWIFTLIBCOMSTR", SCons.Action.Action("$SWIFTLIBCOM", "$SWIFTLIBCOMSTR")
@@ -167,7 +1750,7 @@ def generate(env):
 
     # Module builder for Swift
     env["SWIFTMODULECOM"] = (
-        "$SWIFT -c -emit-module -module-name $SWIFTMODULENAME $SOURCES.abspath $SWIFTMODULEFLAGS $_SWIFT_EMIT_CXX_HEADER_FLAG $_SWIFTCOMCOM"
+        "$SWIFT -c -emit-module -module-name $SWIFTMODULENAME ${SOURCES.srcpath.abspath} $SWIFTMODULEFLAGS $_SWIFT_CMO_FLAGS $_SWIFT_EMIT_CXX_HEADER_FLAG $_SWIFTCOMCOM"
     )
     env["SWIFTMODULECOMSTR"] = env.get(
         "SWIFTMODULECOMSTR",
@@ -175,66 +1758,113 @@ def generate(env):
     )
     env["SWIFTMODULEFLAGS"] = SCons.Util.CLVar("")
 
+    # Typecheck-only mode: modules are emitted without non-inlinable function
+    # bodies so dependents can be checked early, and every Swift target gets
+    # a -typecheck step under the swift-check alias.
+    env["SWIFT_TYPECHECK_ONLY"] = False
+    env["SWIFT_SKIP_FUNCTION_BODIES_FLAGS"] = SCons.Util.CLVar(
+        "-experimental-skip-non-inlinable-function-bodies"
+    )
+    env["SWIFTMODULECHECKCOM"] = (
+        "$SWIFT -emit-module -module-name $SWIFTMODULENAME ${SOURCES.srcpath.abspath} $SWIFTMODULEFLAGS $SWIFT_SKIP_FUNCTION_BODIES_FLAGS $_SWIFT_EMIT_CXX_HEADER_FLAG $_SWIFTCOMCOM"
+    )
+    env["SWIFTMODULECHECKCOMSTR"] = env.get(
+        "SWIFTMODULECHECKCOMSTR",
+        SCons.Action.Action("$SWIFTMODULECHECKCOM", "$SWIFTMODULECHECKCOMSTR"),
+    )
+
+    # Module and objects of SwiftStaticLibrary, built by separate actions
+    # unless CMO or optimized whole-module builds need a single compile
+    env["SWIFTOBJSUFFIX"] = ".o"
+    env["SWIFTEMITMODULECOM"] = (
+        "$SWIFT -emit-module -module-name $SWIFTMODULENAME ${SOURCES.srcpath.abspath} $SWIFTMODULEFLAGS $_SWIFT_CMO_FLAGS $_SWIFT_EMIT_CXX_HEADER_FLAG $_SWIFTCOMCOM"
+    )
+    env["SWIFTEMITMODULECOMSTR"] = env.get(
+        "SWIFTEMITMODULECOMSTR",
+        SCons.Action.Action("$SWIFTEMITMODULECOM", "$SWIFTEMITMODULECOMSTR"),
+    )
+    env["SWIFTOBJECTSCOM"] = (
+        "$SWIFT -c -module-name $SWIFTMODULENAME ${SOURCES.srcpath.abspath} $SWIFTMODULEFLAGS $_SWIFT_CMO_FLAGS $_SWIFTCOMCOM"
+    )
+    env["SWIFTOBJECTSCOMSTR"] = env.get(
+        "SWIFTOBJECTSCOMSTR",
+        SCons.Action.Action("$SWIFTOBJECTSCOM", "$SWIFTOBJECTSCOMSTR"),
+    )
+    env["SWIFT_THIN_ARCHIVE"] = False
+    env["SWIFTTHINARFLAGS"] = "rcT"
+
+    # Typecheck builder for Swift
+    env["SWIFTCHECKSUFFIX"] = ".swiftcheck"
+    env["_SWIFTCHECKMODULENAME"] = (
+        '${SWIFTMODULENAME and "-module-name $SWIFTMODULENAME" or ""}'
+    )
+    env["_SWIFTCHECKBUILDERFLAGS"] = ""
+    env["SWIFTCHECKCOM"] = (
+        "$SWIFT -typecheck $_SWIFTCHECKMODULENAME $SOURCES $SWIFTCHECKFLAGS $_SWIFTCHECKBUILDERFLAGS $_SWIFTCOMCOM"
+    )
+    env["SWIFTCHECKCOMSTR"] = env.get(
+        "SWIFTCHECKCOMSTR", SCons.Action.Action("$SWIFTCHECKCOM", "$SWIFTCHECKCOMSTR")
+    )
+    env["SWIFTCHECKFLAGS"] = SCons.Util.CLVar("")
+
     # Executable builder for Swift
-    env["SWIFTEXECOM"] = "$SWIFT -o $TARGET $SOURCES $SWIFTEXEFLAGS $_LIBDIRFLAGS $_LIBFLAGS $_SWIFTCOMCOM"
+    env["SWIFTEXECOM"] = (
+        "$SWIFT -o $TARGET $SOURCES $SWIFTEXEFLAGS $_SWIFT_BUILD_ID_FLAGS $_LIBDIRFLAGS $_LIBFLAGS $_SWIFTCOMCOM"
+    )
     env["SWIFTEXECOMSTR"] = env.get(
         "SWIFTEXECOMSTR", SCons.Action.Action("$SWIFTEXECOM", "$SWIFTEXECOMSTR")
     )
     env["SWIFTEXEFLAGS"] = SCons.Util.CLVar("")
 
-    # Create Swift-specific builders
+    # Swift-specific builders
+    for name, builder in _swift_create_builders().items():
+        env["BUILDERS"][name] = builder
+    env.AddMethod(SwiftPrebuiltModules, "SwiftPrebuiltModules")
+    env.AddMethod(SwiftVariant, "SwiftVariant")
+    env.AddMethod(SwiftCxxHeaderPch, "SwiftCxxHeaderPch")
+    env.AddMethod(SwiftStaticLibrary, "SwiftStaticLibrary")
 
-    # Swift Module Builder
-    swift_module_builder = SCons.Builder.Builder(
-        action=SCons.Action.Action("$SWIFTMODULECOM", "$SWIFTMODULECOMSTR"),
-        suffix="$SWIFTMODULESUFFIX",
-        src_suffix=SwiftSuffixes,
-        emitter=[_swift_cxx_header_emitter, _swift_obj_emitter, _swift_emitter],
-        chdir=True,
-        single_source=0,
-    )
-    env["BUILDERS"]["SwiftModule"] = swift_module_builder
+    # C++ objects depend on the precompiled Swift headers they include
+    for obj_builder in SCons.Tool.createObjBuilders(env):
+        if obj_builder.target_scanner is None:
+            obj_builder.target_scanner = SwiftCxxPchScanner
 
-    # Swift Library Builder
-    swift_lib_builder = SCons.Builder.Builder(
-        action=SCons.Action.Action("$SWIFTLIBCOM", "$SWIFTLIBCOMSTR"),
-        suffix="$SHLIBSUFFIX",
-        src_suffix=SwiftSuffixes,
-        single_source=0,
-    )
-    env["BUILDERS"]["SwiftLibrary"] = swift_lib_builder
+    # C and C++ objects register their optimization records
+    for obj_builder in SCons.Tool.createObjBuilders(env):
+        for suffix in SCons.Tool.CSuffixes + SCons.Tool.CXXSuffixes:
+            emitter = obj_builder.emitter.get(suffix)
+            if emitter is None or getattr(emitter, "_swift_opt_record", False):
+                continue
+            emitter = SCons.Builder.ListEmitter([emitter, _swift_cc_opt_record_emitter])
+            emitter._swift_opt_record = True
+            obj_builder.add_emitter(suffix, emitter)
 
-    # Swift Program Builder
-    swift_exe_builder = SCons.Builder.Builder(
-        action=SCons.Action.Action("$SWIFTEXECOM", "$SWIFTEXECOMSTR"),
-        suffix="$PROGSUFFIX",
-        src_suffix=SwiftSuffixes,
-        single_source=0,
+    # Programs and libraries of the size report
+    env.Append(
+        PROGEMITTER=[_swift_size_emitter],
+        LIBEMITTER=[_swift_size_emitter],
+        SHLIBEMITTER=[_swift_size_emitter],
     )
-    env["BUILDERS"]["SwiftProgram"] = swift_exe_builder
 
     # Set up platform-specific flags
     if env["PLATFORM"] == "darwin":
         # macOS/iOS specific flags
         env.AppendUnique(SWIFTFLAGS=["-sdk", "$SDKROOT"])
+        env.AppendUnique(SWIFTPREBUILTMODULEFLAGS=["-sdk", "$SDKROOT"])
+        # Mach-O has no debug link: the debug info goes to a flat dSYM,
+        # matched to the binary by its LC_UUID
+        env["SWIFT_DSYMUTIL"] = "dsymutil"
+        env["SWIFT_STRIP"] = "strip"
+        env["SWIFTDEBUGSUFFIX"] = ".dwarf"
+        env["SWIFTDEBUGCOM"] = "$SWIFT_DSYMUTIL --flat -o ${TARGETS[1]} $SOURCE"
+        env["SWIFTSTRIPCOM"] = "$SWIFT_STRIP -S -o $TARGET $SOURCE"
+        env["_SWIFT_BUILD_ID_FLAGS"] = ""
         if not env.get("SDKROOT"):
-            import subprocess
-
-            try:
-                result = subprocess.run(
-                    ["xcrun", "--show-sdk-path"], capture_output=True, text=True
-                )
-                if result.returncode == 0:
-                    env["SDKROOT"] = result.stdout.strip()
-            except:
-                pass
-
-    # Detect Swift version and set version-specific flags
-    version = _detect_swift_version(env, env["SWIFT"])
-    if version:
-        env["SWIFTVERSION"] = version
-        # Could add version-specific flags here
+            env["SDKROOT"] = _swift_sdkroot
 
+    # The compiler version is only queried when first substituted
+    if "SWIFTVERSION" not in env:
+        env["SWIFTVERSION"] = _swift_version
 
 def exists(env):
     """Check if Swift compiler exists"""
@@ -0,0 +1,448 @@
+"""SCons.Tool.swift.worker
+
+Remote execution of Swift frontend jobs.
+
+A job is a command line run in a directory of the build tree: the swiftc
+invocation compiling or emitting one module, so the work is spread over
+the workers module by module, not file by file. Its inputs
+are addressed by the SHA-256 of their contents, so a worker only receives
+the files it has not seen before, and its declared outputs are sent back
+to the build. Workers must have the same toolchain (and SDK) installed at
+the same paths as the build.
+
+Messages are JSON objects, each preceded by its length as a 4-byte big
+endian integer. Every request carries the token shared by the build and
+the worker:
+
+    -> {"op": "run", "token": "...", "args": [...], "cwd": "dir", "env": {...},
+        "inputs": {"path": "sha256", ...}, "outputs": ["path", ...]}
+    <- {"status": "missing", "hashes": ["sha256", ...]}
+    -> {"op": "put", "token": "...", "blobs": {"sha256": "base64", ...}}
+    <- {"status": "ok"}
+    -> {"op": "run", ...}
+    <- {"status": "done", "returncode": 0, "stdout": "...", "stderr": "...",
+        "outputs": {"path": "base64", ...}}
+
+Paths are relative to the top of the build tree, which appears as @ROOT@
+in the arguments. A server runs the jobs in a pool of processes:
+
+    SWIFT_WORKER_TOKEN=secret python worker.py serve --host 0.0.0.0 --jobs 8
+
+A server always requires a token. It only runs the Swift frontend
+(--frontend, by default the swiftc on its PATH), ignores the PATH and
+dynamic loader variables sent with a job, refuses the flags loading
+plugins or response files into the compiler, and rejects arguments naming
+paths outside the job's sandbox, the toolchain and the --allow-path
+directories (such as the SDK).
+"""
+
+#
+# Copyright (c) 2024 The SCons Foundation
+#
+# Permission is hereby granted, free of charge, to any person obtaining
+# a copy of this software and associated documentation files (the
+# "Software"), to deal in the Software without restriction, including
+# without limitation the rights to use, copy, modify, merge, publish,
+# distribute, sublicense, and/or sell copies of the Software, and to
+# permit persons to whom the Software is furnished to do so, subject to
+# the following conditions:
+#
+# The above copyright notice and this permission notice shall be included
+# in all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY
+# KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+# WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+# NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+# LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+# OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+# WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#
+
+import base64
+import hashlib
+import hmac
+import json
+import os
+import re
+import shutil
+import socket
+import socketserver
+import struct
+import subprocess
+import sys
+import tempfile
+
+ROOT = "@ROOT@"
+DEFAULT_PORT = 7420
+
+# Largest message accepted, to fail fast on garbage
+_MAX_MESSAGE = 1 << 30
+
+
+def content_hash(path):
+    """Return the SHA-256 of a file's contents"""
+    digest = hashlib.sha256()
+    with open(path, "rb") as f:
+        for chunk in iter(lambda: f.read(1 << 20), b""):
+            digest.update(chunk)
+    return digest.hexdigest()
+
+
+def send_message(sock, message):
+    data = json.dumps(message).encode()
+    sock.sendall(struct.pack(">I", len(data)) + data)
+
+
+def _recv_exactly(sock, size):
+    chunks = []
+    while size:
+        chunk = sock.recv(min(size, 1 << 20))
+        if not chunk:
+            raise ConnectionError("connection closed by peer")
+        chunks.append(chunk)
+        size -= len(chunk)
+    return b"".join(chunks)
+
+
+def recv_message(sock):
+    (size,) = struct.unpack(">I", _recv_exactly(sock, 4))
+    if size > _MAX_MESSAGE:
+        raise ConnectionError("message of %d bytes is too large" % size)
+    return json.loads(_recv_exactly(sock, size).decode())
+
+
+def _check_relative(path):
+    """Reject paths which would escape the sandbox of a job"""
+    parts = path.replace("\\", "/").split("/")
+    if os.path.isabs(path) or ".." in parts:
+        raise ValueError("invalid path in job: %r" % path)
+    return path
+
+
+def _placeholder(arg, root):
+    """Replace `root`, when it is the whole path or a parent directory, by ROOT"""
+    return re.sub(re.escape(root) + r"(?=$|[/\\])", lambda m: ROOT, arg)
+
+
+def parse_address(address, default_port=DEFAULT_PORT):
+    """Split "host:port" (or "host") into (host, port)"""
+    host, _, port = address.rpartition(":")
+    if not host:
+        return address, default_port
+    return host, int(port)
+
+
+# Client
+
+
+def run(address, args, cwd, root, inputs, outputs, env=None, timeout=None, token=None):
+    """Run a job on the worker at `address`.
+
+    `args` and `cwd` may use absolute paths inside `root`, `inputs` and
+    `outputs` are absolute paths of files inside `root`. The outputs are
+    written back in place, and only those. Return (returncode, stdout,
+    stderr). Raise OSError when the worker cannot be reached, or ValueError
+    or KeyError on a malformed reply, so callers can fall back to running
+    the job locally.
+    """
+    root = os.path.abspath(root)
+
+    def relative(path):
+        return os.path.relpath(os.path.abspath(path), root).replace(os.sep, "/")
+
+    hashes = {}
+    for path in inputs:
+        hashes[relative(path)] = content_hash(path)
+    request = {
+        "op": "run",
+        "token": token or "",
+        "args": [_placeholder(arg, root) for arg in args],
+        "cwd": relative(cwd),
+        "env": dict(env or {}),
+        "inputs": hashes,
+        "outputs": [relative(path) for path in outputs],
+    }
+
+    with socket.create_connection(parse_address(address), timeout=timeout) as sock:
+        send_message(sock, request)
+        reply = recv_message(sock)
+        if reply.get("status") == "missing":
+            by_hash = {digest: rel for rel, digest in hashes.items()}
+            blobs = {}
+            for digest in reply["hashes"]:
+                with open(os.path.join(root, by_hash[digest]), "rb") as f:
+                    blobs[digest] = base64.b64encode(f.read()).decode()
+            send_message(sock, {"op": "put", "token": token or "", "blobs": blobs})
+            if recv_message(sock).get("status") != "ok":
+                raise ConnectionError("worker rejected the inputs")
+            send_message(sock, request)
+            reply = recv_message(sock)
+
+    if reply.get("status") != "done":
+        raise ConnectionError("worker failed: %s" % reply.get("error", reply))
+    expected = set(request["outputs"])
+    for rel, data in reply["outputs"].items():
+        if rel not in expected:
+            raise ValueError("worker returned an unrequested output: %r" % rel)
+        path = os.path.join(root, _check_relative(rel))
+        os.makedirs(os.path.dirname(path), exist_ok=True)
+        with open(path, "wb") as f:
+            f.write(base64.b64decode(data))
+    return reply["returncode"], reply["stdout"], reply["stderr"]
+
+
+# Server
+
+
+class _BlobStore:
+    """Inputs received by the worker, stored by content hash"""
+
+    def __init__(self, path):
+        self.path = path
+        os.makedirs(path, exist_ok=True)
+
+    def blob(self, digest):
+        if not all(c in "0123456789abcdef" for c in digest):
+            raise ValueError("invalid content hash: %r" % digest)
+        return os.path.join(self.path, digest)
+
+    def missing(self, digests):
+        return sorted({d for d in digests if not os.path.exists(self.blob(d))})
+
+    def put(self, digest, data):
+        if hashlib.sha256(data).hexdigest() != digest:
+            raise ValueError("content does not match hash %s" % digest)
+        fd, tmp = tempfile.mkstemp(dir=self.path)
+        with os.fdopen(fd, "wb") as f:
+            f.write(data)
+        os.replace(tmp, self.blob(digest))
+
+    def materialize(self, digest, path):
+        os.makedirs(os.path.dirname(path), exist_ok=True)
+        try:
+            os.link(self.blob(digest), path)
+        except OSError:
+            shutil.copyfile(self.blob(digest), path)
+
+
+class _JobHandler(socketserver.BaseRequestHandler):
+    def handle(self):
+        try:
+            while True:
+                try:
+                    message = recv_message(self.request)
+                except ConnectionError:
+                    return
+                send_message(self.request, self.dispatch(message))
+        except Exception as e:
+            try:
+                send_message(self.request, {"status": "error", "error": str(e)})
+            except OSError:
+                pass
+
+    def dispatch(self, message):
+        store = self.server.store
+        if not hmac.compare_digest(str(message.get("token", "")), self.server.token):
+            raise PermissionError("invalid token")
+        if message.get("op") == "put":
+            for digest, data in message["blobs"].items():
+                store.put(digest, base64.b64decode(data))
+            return {"status": "ok"}
+        if message.get("op") == "run":
+            missing = store.missing(message["inputs"].values())
+            if missing:
+                return {"status": "missing", "hashes": missing}
+            return self.run_job(message)
+        raise ValueError("unknown operation %r" % message.get("op"))
+
+    def run_job(self, job):
+        store = self.server.store
+        sandbox = os.path.realpath(tempfile.mkdtemp(prefix="swift-job-"))
+        try:
+            for rel, digest in job["inputs"].items():
+                store.materialize(digest, os.path.join(sandbox, _check_relative(rel)))
+            cwd = os.path.join(sandbox, _check_relative(job["cwd"]))
+            os.makedirs(cwd, exist_ok=True)
+            for rel in job["outputs"]:
+                os.makedirs(
+                    os.path.dirname(os.path.join(sandbox, _check_relative(rel))),
+                    exist_ok=True,
+                )
+
+            args = [arg.replace(ROOT, sandbox) for arg in job["args"]]
+            if not args or _resolve(args[0]) not in self.server.frontends:
+                raise PermissionError("not a Swift frontend: %r" % args[:1])
+            _check_args(args[1:], cwd, [sandbox] + self.server.allowed_paths)
+            for rel in job["outputs"]:
+                if not _inside(os.path.join(sandbox, rel), [sandbox]):
+                    raise PermissionError("output outside the sandbox: %r" % rel)
+            environ = dict(os.environ)
+            for name, value in job.get("env", {}).items():
+                if name != "PATH" and not name.startswith(_LOADER_PREFIXES):
+                    environ[name] = value
+            result = subprocess.run(
+                args,
+                cwd=cwd,
+                env=environ,
+                capture_output=True,
+                text=True,
+            )
+
+            outputs = {}
+            for rel in job["outputs"]:
+                path = os.path.join(sandbox, rel)
+                if os.path.isfile(path):
+                    with open(path, "rb") as f:
+                        outputs[rel] = base64.b64encode(f.read()).decode()
+            return {
+                "status": "done",
+                "returncode": result.returncode,
+                "stdout": result.stdout.replace(sandbox, ROOT),
+                "stderr": result.stderr.replace(sandbox, ROOT),
+                "outputs": outputs,
+            }
+        finally:
+            shutil.rmtree(sandbox, ignore_errors=True)
+
+
+# Variables of the job environment which would change what the frontend runs
+_LOADER_PREFIXES = ("LD_", "DYLD_")
+
+# Flags loading code into the frontend, directly or through -Xcc, -Xclang
+# and -Xllvm, or redirecting its file system
+_FORBIDDEN_FLAG_RE = re.compile(
+    r"^--?(?:load|plugin-path|external-plugin-path|in-process-plugin-server-path"
+    r"|fplugin|fpass-plugin|i?vfsoverlay)"
+)
+
+
+def _inside(path, roots):
+    """Whether `path` resolves to one of the `roots` or below"""
+    path = os.path.realpath(path)
+    return any(path == root or path.startswith(root + os.sep) for root in roots)
+
+
+def _check_args(args, cwd, roots):
+    """Reject plugin and response file arguments, and paths outside `roots`.
+
+    A path is an argument, the value after its "=" or after a one letter
+    flag such as -I; relative ones only matter when they go up with "..".
+    """
+    for arg in args:
+        if arg.startswith("@") or _FORBIDDEN_FLAG_RE.match(arg):
+            raise PermissionError("argument not allowed in a job: %r" % arg)
+        paths = [arg]
+        if "=" in arg:
+            paths.append(arg.split("=", 1)[1])
+        if re.match(r"-[A-Za-z]", arg):
+            paths.append(arg[2:])
+        for path in paths:
+            if os.path.isabs(path) or ".." in path.replace("\\", "/").split("/"):
+                if not _inside(os.path.join(cwd, path), roots):
+                    raise PermissionError("path outside the sandbox: %r" % arg)
+
+
+def _resolve(program):
+    """Real path of `program`, looked up in the worker's own PATH"""
+    path = shutil.which(program)
+    return os.path.realpath(path) if path else None
+
+
+def _toolchain_root(frontend):
+    """Directory holding the bin directory of `frontend`, with the toolchain's
+    headers, libraries and modules"""
+    root = os.path.dirname(os.path.dirname(frontend))
+    return root if root != os.path.dirname(root) else None
+
+
+if hasattr(socketserver, "ForkingMixIn"):
+
+    class _Server(socketserver.ForkingMixIn, socketserver.TCPServer):
+        allow_reuse_address = True
+
+else:
+
+    class _Server(socketserver.ThreadingMixIn, socketserver.TCPServer):
+        allow_reuse_address = True
+
+
+def serve(
+    host="127.0.0.1",
+    port=DEFAULT_PORT,
+    jobs=None,
+    store=None,
+    token=None,
+    frontends=None,
+    allow_paths=None,
+):
+    """Serve jobs until interrupted, running at most `jobs` at a time.
+
+    Only the `frontends` executables (by default swiftc) are run, for
+    clients sending `token`. Arguments may only name paths in the job's
+    sandbox, the toolchains of the frontends and `allow_paths`.
+    """
+    if not token:
+        raise ValueError("a token is required to serve jobs (set SWIFT_WORKER_TOKEN)")
+    allowed = {_resolve(f) for f in (frontends or ["swiftc"])} - {None}
+    if not allowed:
+        raise ValueError("no Swift frontend found among %r" % (frontends or ["swiftc"]))
+    server = _Server((host, port), _JobHandler)
+    server.token = token
+    server.frontends = allowed
+    server.allowed_paths = sorted(
+        {_toolchain_root(f) for f in allowed} - {None}
+        | {os.path.realpath(p) for p in (allow_paths or [])}
+    )
+    server.max_children = jobs or os.cpu_count() or 1
+    server.store = _BlobStore(
+        store or os.path.join(tempfile.gettempdir(), "swift-worker-store")
+    )
+    with server:
+        try:
+            server.serve_forever()
+        except KeyboardInterrupt:
+            pass
+
+
+def main(argv):
+    import argparse
+
+    parser = argparse.ArgumentParser(description="Run Swift frontend jobs for SCons")
+    sub = parser.add_subparsers(dest="command", required=True)
+    serve_parser = sub.add_parser("serve", help="serve jobs over TCP")
+    serve_parser.add_argument("--host", default="127.0.0.1")
+    serve_parser.add_argument("--port", type=int, default=DEFAULT_PORT)
+    serve_parser.add_argument("--jobs", type=int, default=None)
+    serve_parser.add_argument("--store", default=None, help="input cache directory")
+    serve_parser.add_argument(
+        "--frontend",
+        action="append",
+        default=None,
+        help="executable jobs may run (repeatable, default: swiftc)",
+    )
+    serve_parser.add_argument(
+        "--allow-path",
+        action="append",
+        default=None,
+        help="directory outside the toolchain jobs may name, such as the SDK (repeatable)",
+    )
+    options = parser.parse_args(argv)
+
+    try:
+        serve(
+            options.host,
+            options.port,
+            options.jobs,
+            options.store,
+            os.environ.get("SWIFT_WORKER_TOKEN"),
+            options.frontend,
+            options.allow_path,
+        )
+    except ValueError as e:
+        parser.error(str(e))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv[1:]))